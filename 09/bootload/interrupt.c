@@ -0,0 +1,30 @@
+#include "defines.h"
+#include "intr.h"
+#include "interrupt.h"
+
+/*ソフトウェア割り込みベクタの初期化*/
+int softvec_init(void)
+{
+  int type;
+  for(type = 0; type < SOFTVEC_TYPENUM; type++)
+    softvec_setintr(type, NULL);
+  return 0;
+}
+
+/*ソフトウェア割り込みベクタの設定*/
+int softvec_setintr(softvec_type_t type, softvec_handler_t handler)
+{
+  SOFTVEC[type] = handler;
+  return 0;
+}
+
+/*
+ * 共通割り込みハンドラ
+ * ソフトウェア割り込みベクタを見て、各ハンドラに分岐する
+ */
+void interrupt(softvec_type_t type, unsigned long sp)
+{
+  softvec_handler_t handler = SOFTVEC[type];
+  if(handler)
+    handler(type, sp);
+}
@@ -1,4 +1,5 @@
 #include "defines.h"
+#include "interrupt.h"
 #include "serial.h"
 #include "xmodem.h"
 #include "lib.h"
@@ -9,6 +10,9 @@ static int init(void){
   memcpy(&data_start, &erodata, (long)&edata - (long)&data_start);
   memset(&bss_start, 0, (long)&ebss - (long)&bss_start);
 
+  /*ソフトウェア・割り込みベクタを初期化する*/
+  softvec_init();
+
   serial_init(SERIAL_DEFAULT_DEVICE);
 
   return 0;
@@ -54,6 +58,8 @@ int main(void)
   char *entry_point;
   void (*f)(void);
   
+  INTR_DISABLE; /*OSが設定するまで割り込みは無効にしておく*/
+
   init();
 
   puts("kzload start\n");
@@ -1,17 +1,26 @@
 #include "defines.h"
 
 extern void start(void);
+extern void intr_softerr(void); /*ソフトウェア・エラー*/
+extern void intr_syscall(void); /*システム・コール*/
+extern void intr_serintr(void); /*シリアル割り込み*/
+extern void intr_timintr(void); /*タイマ割り込み*/
 
 /*
-This is Stuck
+  割り込みベクタの設定
+  リンカ・スクリプトの定義により、先頭番地に配置される。
+  各ハンドラはintr.Sにあり、RAM上のソフトウェア割り込みベクタを
+  経由してOSのハンドラを呼び出す
 */
 void (*vectors[])(void) = {
   start, NULL, NULL, NULL, NULL, NULL, NULL, NULL,
+  intr_syscall, intr_softerr, intr_softerr, intr_softerr, /*8-11:TRAPA #0-#3*/
   NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL,
   NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL,
   NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL,
+  intr_timintr, NULL, NULL, NULL, NULL, NULL, NULL, NULL, /*36:CMIA0*/
   NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL,
-  NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL,
-  NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL,
-  NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL
+  intr_serintr, intr_serintr, intr_serintr, intr_serintr, /*52-55:SCI0*/
+  intr_serintr, intr_serintr, intr_serintr, intr_serintr, /*56-59:SCI1*/
+  intr_serintr, intr_serintr, intr_serintr, intr_serintr, /*60-63:SCI2*/
 };
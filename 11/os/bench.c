@@ -0,0 +1,423 @@
+#include "defines.h"
+#include "kozos.h"
+#include "timer.h"
+#include "lib.h"
+
+/*
+  カーネルのマイクロベンチマーク
+  16ビットタイマをφ/1で動かし、オーバーフローを数えて32ビットに広げた
+  カウンタでCPUのステート数を測り、
+  各項目の最小/平均/最大を表示する(値は16進数)。
+  結果を比較できるように、回数と順序は固定にしている
+*/
+
+#define BENCH_LOOP 32 /*1項目あたりの計測回数*/
+#define BENCH_PRI 2 /*ベンチマーク・スレッドの優先度*/
+#define BENCH_LOWPRI 14 /*アイドル・スレッド(優先度15)の直前の優先度*/
+#define BENCH_BURST 4 /*まとめて受信するメッセージの数(カーネルのバッファが足りる範囲)*/
+
+typedef struct{
+  uint32 min;
+  uint32 max;
+  uint32 sum;
+  int num;
+}bench_result;
+
+static uint32 overhead; /*計測そのもののステート数*/
+
+static void bench_clear(bench_result *r)
+{
+  r->min = 0xffffffff;
+  r->max = 0;
+  r->sum = 0;
+  r->num = 0;
+}
+
+/*計測したステート数をそのまま記録する*/
+static void bench_record(bench_result *r, uint32 cycles)
+{
+  if(cycles < r->min)
+    r->min = cycles;
+  if(cycles > r->max)
+    r->max = cycles;
+  r->sum += cycles;
+  r->num++;
+}
+
+/*前後で読んだタイマの差から、計測そのもののステート数を差し引いて記録する*/
+static void bench_add(bench_result *r, uint32 start, uint32 end)
+{
+  uint32 cycles = end - start;
+
+  bench_record(r, (cycles > overhead) ? cycles - overhead : 0);
+}
+
+static void bench_print(char *name, bench_result *r)
+{
+  puts(name);
+  puts(": min ");
+  putxval(r->min, 4);
+  puts(" avg ");
+  putxval(r->num ? r->sum / r->num : 0, 4);
+  puts(" max ");
+  putxval(r->max, 4);
+  puts("\n");
+}
+
+/*計測の前後でタイマを読むだけのステート数を求めて差し引く*/
+static void bench_calibrate(void)
+{
+  int i;
+  uint32 start, cycles;
+
+  overhead = 0xffffffff;
+  for(i = 0; i < BENCH_LOOP; i++){
+    start = timer_cycle();
+    cycles = timer_cycle() - start;
+    if(cycles < overhead)
+      overhead = cycles;
+  }
+}
+
+/*切り替えの起きないシステムコール(トラップの出入りとディスパッチの分)*/
+static void bench_syscall(void)
+{
+  int i;
+  uint32 start;
+  bench_result r;
+
+  bench_clear(&r);
+  for(i = 0; i < BENCH_LOOP; i++){
+    start = timer_cycle();
+    kz_getid();
+    bench_add(&r, start, timer_cycle());
+  }
+  bench_print("kz_getid", &r);
+}
+
+static uint32 bench_stamp; /*生成したスレッドが動き出した時刻*/
+
+/*
+  動き出した時刻を記録してすぐに眠るスレッド
+  終了は計測の外で、起こされてから行う(終了の計測はbench_exit()で行う)
+*/
+static int bench_quiet_main(int argc, char *argv[])
+{
+  bench_stamp = timer_cycle();
+  kz_sleep();
+  kz_exit_quiet();
+  return 0;
+}
+
+/*スレッドの生成から動き出すまで(生成するスレッドの方が優先度が高い)*/
+static void bench_thread(void)
+{
+  int i;
+  uint32 start;
+  kz_thread_id_t id;
+  bench_result r;
+
+  bench_clear(&r);
+  for(i = 0; i < BENCH_LOOP; i++){
+    start = timer_cycle();
+    id = kz_run(bench_quiet_main, "quiet", BENCH_PRI - 1, 0, 0x100, NULL, 0, NULL);
+    bench_add(&r, start, bench_stamp);
+    kz_wakeup(id);
+  }
+  bench_print("kz_run->thread", &r);
+}
+
+/*終了する直前の時刻を記録して、表示なしで終了するスレッド*/
+static int bench_exit_main(int argc, char *argv[])
+{
+  bench_stamp = timer_cycle();
+  kz_exit_quiet();
+  return 0;
+}
+
+/*スレッドの終了から生成したスレッドに戻るまで(スタックとTCBの解放を含む)*/
+static void bench_exit(void)
+{
+  int i;
+  bench_result r;
+
+  bench_clear(&r);
+  for(i = 0; i < BENCH_LOOP; i++){
+    kz_run(bench_exit_main, "quiet", BENCH_PRI - 1, 0, 0x100, NULL, 0, NULL);
+    bench_add(&r, bench_stamp, timer_cycle());
+  }
+  bench_print("kz_exit->thread", &r);
+}
+
+/*同じ優先度に他のスレッドがいない状態でのkz_wait()*/
+static void bench_wait(void)
+{
+  int i;
+  uint32 start;
+  bench_result r;
+
+  bench_clear(&r);
+  kz_wait();
+  for(i = 0; i < BENCH_LOOP; i++){
+    start = timer_cycle();
+    kz_wait();
+    bench_add(&r, start, timer_cycle());
+  }
+  bench_print("kz_wait", &r);
+}
+
+/*
+  最も低い優先度(アイドル・スレッドの直前)でのkz_wait()
+  優先度を順に調べるスケジューラでは、ここが最も遅くなる
+*/
+static void bench_wait_lowpri(void)
+{
+  int i, old;
+  uint32 start;
+  bench_result r;
+
+  bench_clear(&r);
+  old = kz_chpri(BENCH_LOWPRI);
+  kz_wait();
+  for(i = 0; i < BENCH_LOOP; i++){
+    start = timer_cycle();
+    kz_wait();
+    bench_add(&r, start, timer_cycle());
+  }
+  kz_chpri(old);
+  bench_print("kz_wait(low priority)", &r);
+}
+
+/*受け取ったメッセージをそのまま送り返す相手スレッド*/
+static int bench_pong_main(int argc, char *argv[])
+{
+  int i, size;
+  char *p;
+
+  for(i = 0; i < BENCH_LOOP + 1; i++){
+    kz_recv(MSGBOX_ID_MSGBOX1, &size, &p);
+    kz_send(MSGBOX_ID_MSGBOX2, size, p);
+  }
+  return 0;
+}
+
+/*kz_send()からkz_recv()で応答を受け取るまでの往復*/
+static void bench_pingpong(void)
+{
+  int i, size;
+  uint32 start;
+  char *p;
+  bench_result r;
+
+  bench_clear(&r);
+  kz_run(bench_pong_main, "pong", BENCH_PRI - 1, 0, 0x100, NULL, 0, NULL);
+  kz_send(MSGBOX_ID_MSGBOX1, 0, NULL);
+  kz_recv(MSGBOX_ID_MSGBOX2, &size, &p);
+  for(i = 0; i < BENCH_LOOP; i++){
+    start = timer_cycle();
+    kz_send(MSGBOX_ID_MSGBOX1, 0, NULL);
+    kz_recv(MSGBOX_ID_MSGBOX2, &size, &p);
+    bench_add(&r, start, timer_cycle());
+  }
+  bench_print("kz_send+kz_recv", &r);
+}
+
+/*受け取ったメッセージの領域をkz_msg_send()で送り返す相手スレッド*/
+static int bench_msgpong_main(int argc, char *argv[])
+{
+  int i, size;
+  char *p;
+
+  for(i = 0; i < BENCH_LOOP + 1; i++){
+    kz_recv(MSGBOX_ID_MSGBOX1, &size, &p);
+    kz_msg_send(MSGBOX_ID_MSGBOX2, size, p);
+  }
+  return 0;
+}
+
+/*kz_msg_send()からkz_recv()で応答を受け取るまでの往復(カーネルはバッファを獲得しない)*/
+static void bench_msgpingpong(void)
+{
+  int i, size;
+  uint32 start;
+  char *p;
+  bench_result r;
+
+  bench_clear(&r);
+  kz_run(bench_msgpong_main, "msgpong", BENCH_PRI - 1, 0, 0x100, NULL, 0, NULL);
+  p = kz_msg_alloc(8);
+  kz_msg_send(MSGBOX_ID_MSGBOX1, 8, p);
+  kz_recv(MSGBOX_ID_MSGBOX2, &size, &p);
+  for(i = 0; i < BENCH_LOOP; i++){
+    start = timer_cycle();
+    kz_msg_send(MSGBOX_ID_MSGBOX1, size, p);
+    kz_recv(MSGBOX_ID_MSGBOX2, &size, &p);
+    bench_add(&r, start, timer_cycle());
+  }
+  kz_msg_free(p);
+  bench_print("kz_msg_send+kz_recv", &r);
+}
+
+/*kz_call()の要求をそのまま応答として返すサーバ*/
+static int bench_server_main(int argc, char *argv[])
+{
+  int i, size;
+  char *p;
+  kz_thread_id_t id;
+
+  for(i = 0; i < BENCH_LOOP + 1; i++){
+    id = kz_recv(MSGBOX_ID_MSGBOX1, &size, &p);
+    kz_reply(id, size, p);
+  }
+  return 0;
+}
+
+/*kz_call()からkz_reply()の応答を受け取るまで*/
+static void bench_call(void)
+{
+  int i;
+  uint32 start;
+  char *p;
+  bench_result r;
+
+  bench_clear(&r);
+  kz_run(bench_server_main, "server", BENCH_PRI - 1, 0, 0x100, NULL, 0, NULL);
+  kz_call(MSGBOX_ID_MSGBOX1, 0, NULL, &p);
+  for(i = 0; i < BENCH_LOOP; i++){
+    start = timer_cycle();
+    kz_call(MSGBOX_ID_MSGBOX1, 0, NULL, &p);
+    bench_add(&r, start, timer_cycle());
+  }
+  bench_print("kz_call+kz_reply", &r);
+}
+
+/*溜まっているBENCH_BURST個のメッセージを、kz_recv()とkz_recv_batch()で受信する*/
+static void bench_burst(void)
+{
+  int i, j, size;
+  uint32 start;
+  char *p;
+  kz_msgvec vec[BENCH_BURST];
+  bench_result rr, rb;
+
+  bench_clear(&rr);
+  bench_clear(&rb);
+  for(i = 0; i < BENCH_LOOP; i++){
+    for(j = 0; j < BENCH_BURST; j++)
+      kz_send(MSGBOX_ID_MSGBOX1, 0, NULL);
+    start = timer_cycle();
+    for(j = 0; j < BENCH_BURST; j++)
+      kz_recv(MSGBOX_ID_MSGBOX1, &size, &p);
+    bench_add(&rr, start, timer_cycle());
+
+    for(j = 0; j < BENCH_BURST; j++)
+      kz_send(MSGBOX_ID_MSGBOX1, 0, NULL);
+    start = timer_cycle();
+    kz_recv_batch(MSGBOX_ID_MSGBOX1, vec, BENCH_BURST);
+    bench_add(&rb, start, timer_cycle());
+  }
+  bench_print("kz_recv x4", &rr);
+  bench_print("kz_recv_batch(4)", &rb);
+}
+
+/*メモリ・プールごとのkz_kmalloc(), kz_kmfree()*/
+static void bench_kmalloc(void)
+{
+  /*H8では16, 32, 64バイトのプールに入る大きさ(ホストではヘッダが大きいので、ずれる)*/
+  static int sizes[] = { 8, 16, 40 };
+  static char *names[][2] = {
+    { "kz_kmalloc(8)", "kz_kmfree(8)" },
+    { "kz_kmalloc(16)", "kz_kmfree(16)" },
+    { "kz_kmalloc(40)", "kz_kmfree(40)" },
+  };
+  int i, j;
+  uint32 start;
+  char *p;
+  bench_result ra, rf;
+
+  for(j = 0; j < sizeof(sizes) / sizeof(*sizes); j++){
+    bench_clear(&ra);
+    bench_clear(&rf);
+    kz_kmfree(kz_kmalloc(sizes[j]));
+    for(i = 0; i < BENCH_LOOP; i++){
+      start = timer_cycle();
+      p = kz_kmalloc(sizes[j]);
+      bench_add(&ra, start, timer_cycle());
+      start = timer_cycle();
+      kz_kmfree(p);
+      bench_add(&rf, start, timer_cycle());
+    }
+    bench_print(names[j][0], &ra);
+    bench_print(names[j][1], &rf);
+  }
+}
+
+/*
+  割り込みからスレッドが動き出すまで
+  kz_delay(1)はティックのコンペアマッチで起床するので、起床直後の
+  ティックのカウンタの値がそのまま遅延になる(1カウント = 64ステート)。
+  前後でタイマを読む計測ではないので、overheadは差し引かない
+*/
+static void bench_latency(void)
+{
+  int i;
+  bench_result r;
+
+  bench_clear(&r);
+  kz_delay(1);
+  for(i = 0; i < BENCH_LOOP; i++){
+    kz_delay(1);
+    bench_record(&r, timer_count() * 64);
+  }
+  bench_print("tick->thread", &r);
+}
+
+/*メモリ・プールの使用状況(KZMEM_POOLSの調整用)*/
+static void bench_kmstat(void)
+{
+  kz_memstat stats[8];
+  int i, num;
+
+  num = kz_kmstat(stats, sizeof(stats) / sizeof(*stats));
+  for(i = 0; (i < num) && (i < sizeof(stats) / sizeof(*stats)); i++){
+    puts("pool ");
+    putxval(stats[i].size, 2);
+    puts(": num ");
+    putxval(stats[i].num, 2);
+    puts(" peak ");
+    putxval(stats[i].peak, 2);
+    puts(" allocs ");
+    putxval(stats[i].allocs, 4);
+    puts(" fails ");
+    putxval(stats[i].fails, 2);
+    puts("\n");
+  }
+}
+
+int bench_main(int argc, char *argv[])
+{
+#ifdef KZ_HOSTED
+  puts("kozos benchmark (nsec, hex)\n"); /*ホストのtimer_cycle()はナノ秒*/
+#else
+  puts("kozos benchmark (cycles, hex)\n");
+#endif
+
+  timer_cycle_init();
+  bench_calibrate();
+
+  bench_syscall();
+  bench_thread();
+  bench_exit();
+  bench_wait();
+  bench_wait_lowpri();
+  bench_pingpong();
+  bench_msgpingpong();
+  bench_call();
+  bench_burst();
+  bench_kmalloc();
+  bench_latency();
+  bench_kmstat();
+
+  puts("benchmark done\n");
+  return 0;
+}
@@ -0,0 +1,106 @@
+#include "defines.h"
+#include "kozos.h"
+#include "intr.h"
+#include "interrupt.h"
+#include "serial.h"
+#include "trace.h"
+#include "lib.h"
+
+/*
+  コンソール・ドライバ
+  シリアルの受信割り込みで受け取った文字を割り込みハンドラで1行分ためて、
+  改行でkx_send()によりメッセージボックス"console"に送り、スレッドで処理する
+*/
+
+#define CONS_LINE_SIZE 32
+#define CONS_LINE_NUM 2
+
+static kz_msgbox_id_t consbox;
+static char consline[CONS_LINE_NUM][CONS_LINE_SIZE];
+static volatile uint8 consline_busy[CONS_LINE_NUM]; /*スレッドに送って処理待ちの行*/
+static int consline_index; /*受信中の行*/
+static int consline_len;
+static int consline_drop; /*行の途中で文字を失ったので、改行まで捨てる*/
+
+/*
+  シリアル割り込みのハンドラ
+  受信中の行がまだスレッドで処理されていなければ、その行は捨てる
+*/
+static void consdrv_intr(void)
+{
+  unsigned char c;
+  char *line;
+  int size;
+
+  while(1){
+    /*受信エラーはフラグを落とさないと割り込みが続くので、その行ごと捨てる*/
+    if(serial_recv_error(SERIAL_DEFAULT_DEVICE)){
+      consline_drop = 1;
+      continue;
+    }
+    if(!serial_is_recv_enable(SERIAL_DEFAULT_DEVICE))
+      break;
+
+    c = serial_recv_byte(SERIAL_DEFAULT_DEVICE);
+    if(c == '\r')
+      c = '\n';
+    if(consline_busy[consline_index])
+      consline_drop = 1;
+    if(consline_drop){
+      if(c == '\n'){
+	consline_drop = 0;
+	consline_len = 0;
+      }
+      continue;
+    }
+
+    line = consline[consline_index];
+    if(c != '\n'){
+      if(consline_len < CONS_LINE_SIZE - 1)
+	line[consline_len++] = c;
+      continue;
+    }
+    line[consline_len] = '\0';
+    size = consline_len;
+    consline_len = 0;
+    /*メッセージ・バッファが足りなければその行は捨てて、同じ領域で受信し直す*/
+    if(kx_send(consbox, size, line) < 0)
+      continue;
+    consline_busy[consline_index] = 1;
+    consline_index = (consline_index + 1) % CONS_LINE_NUM;
+  }
+}
+
+/*
+  受信した行の処理
+  "trace"ならカーネル・イベントのトレースを出力し、それ以外はエコーバックする
+*/
+static void consdrv_command(int size, char *line)
+{
+#ifdef KZ_TRACE
+  if(!strcmp(line, "trace")){
+    kztrace_dump();
+    return;
+  }
+#endif
+  puts(line);
+  puts("\n");
+}
+
+int consdrv_main(int argc, char *argv[])
+{
+  int size;
+  char *line;
+
+  consbox = kz_msgbox_create("console");
+  kz_setintr(SOFTVEC_TYPE_SERINTR, consdrv_intr);
+  serial_intr_recv_enable(SERIAL_DEFAULT_DEVICE);
+
+  while(1){
+    kz_recv(consbox, &size, &line);
+    consdrv_command(size, line);
+    consline_busy[(line - consline[0]) / CONS_LINE_SIZE] = 0;
+  }
+
+  return 0;
+}
@@ -11,11 +11,16 @@ typedef unsigned long uint32;
 typedef uint32 kz_thread_id_t;
 typedef int (*kz_func_t)(int argc, char *argv[]);
 typedef void (*kz_handler_t)(void);
+typedef int kz_mutex_id_t;
+typedef int kz_sem_id_t;
 
-typedef enum{
+typedef uint32 kz_msgbox_id_t;
+
+/*起動時からある固定のメッセージボックス(それ以外はkz_msgbox_create()で作る)*/
+enum{
   MSGBOX_ID_MSGBOX1 = 0,
   MSGBOX_ID_MSGBOX2,
   MSGBOX_ID_NUM,  
-}kz_msgbox_id_t;
+};
 
 #endif
@@ -0,0 +1,185 @@
+#include <signal.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <ucontext.h>
+#include "defines.h"
+#include "intr.h"
+#include "interrupt.h"
+
+/*
+  ホスト(Linux)上でカーネルを動かすためのCPU依存部
+  startup.s(dispatch), intr.S, trapaの代わりに、ucontextによる
+  コンテキスト切替えとシグナルによる割り込みを提供する。
+  割り込み禁止はSIGALRM(タイマ割り込み)とSIGIO(シリアル割り込み)を
+  ブロックすることで表す
+*/
+
+#define HOST_INTRSTACK_SIZE 0x10000 /*割り込みスタックのサイズ*/
+#define HOST_USERSTACK_SIZE 0x100000 /*スレッドのスタック領域のサイズ*/
+#define HOST_FREEAREA_SIZE 0x1000 /*メモリ・プールの領域のサイズ*/
+
+#define HOST_STR(x) HOST_STR2(x)
+#define HOST_STR2(x) #x
+
+/*リンカスクリプトで定義している領域(memory.cから参照する)*/
+asm(".bss\n"
+    ".globl freearea\n"
+    ".globl efreearea\n"
+    ".balign 16\n"
+    "freearea:\n"
+    ".space " HOST_STR(HOST_FREEAREA_SIZE) "\n"
+    "efreearea:\n"
+    ".globl userstack\n"
+    ".globl euserstack\n"
+    ".balign 16\n"
+    "userstack:\n"
+    ".space " HOST_STR(HOST_USERSTACK_SIZE) "\n"
+    "euserstack:\n"
+    ".globl intrstack_limit\n"
+    ".balign 16\n"
+    "intrstack_limit:\n"
+    ".space " HOST_STR(HOST_INTRSTACK_SIZE) "\n"
+    ".globl intrstack\n"
+    "intrstack:\n"
+    ".text\n");
+
+softvec_handler_t host_softvecs[SOFTVEC_TYPE_NUM]; /*ソフトウェア割り込みベクタ*/
+
+static sigset_t intrmask; /*割り込みとして扱うシグナル*/
+static ucontext_t intrctx; /*割り込み処理のコンテキスト*/
+extern char intrstack_limit[]; /*割り込みスタックの下端(kozos.cが番兵を置く)*/
+static softvec_type_t intrtype;
+static unsigned long intrsp;
+
+/*スレッドの初期コンテキスト(スタックの上端に置く)*/
+typedef struct{
+  ucontext_t uc;
+  void (*func)(void *);
+  void *arg;
+  int intr; /*割り込みを許可して開始するなら1*/
+}host_frame;
+
+/*ブートローダの代わりに、割り込みを禁止した状態から開始する*/
+static void host_init(void) __attribute__((constructor));
+static void host_init(void)
+{
+  sigemptyset(&intrmask);
+  sigaddset(&intrmask, SIGALRM);
+  sigaddset(&intrmask, SIGIO);
+  sigprocmask(SIG_BLOCK, &intrmask, NULL);
+  getcontext(&intrctx);
+}
+
+void host_intr_enable(void)
+{
+  sigprocmask(SIG_UNBLOCK, &intrmask, NULL);
+}
+
+void host_intr_disable(void)
+{
+  sigprocmask(SIG_BLOCK, &intrmask, NULL);
+}
+
+/*割り込みが発生するまで待つ(sleep命令に相当)*/
+void host_intr_wait(void)
+{
+  sigset_t mask;
+
+  sigemptyset(&mask);
+  sigsuspend(&mask);
+}
+
+void host_halt(void)
+{
+  exit(1);
+}
+
+/*テストの終了(終了コードを返してプロセスを終える)*/
+void host_exit(int status)
+{
+  exit(status);
+}
+
+/*
+  割り込みスタック上で共通割り込みハンドラを呼ぶ(intr.Sに相当)
+  カーネルはdispatch()で戻ってくるので、通常はここに戻らない
+*/
+static void host_intr_entry(void)
+{
+  interrupt(intrtype, intrsp);
+  setcontext((ucontext_t *)intrsp);
+}
+
+/*
+  割り込み(トラップ)の発生
+  コンテキストを呼び出し元のスタックに保存し、その位置をspとして
+  カーネルに渡す。スレッドからはtrapa、シグナル・ハンドラからは
+  割り込みの入り口として呼ばれる
+*/
+void host_intr(softvec_type_t type)
+{
+  ucontext_t uc;
+  sigset_t old;
+
+  sigprocmask(SIG_BLOCK, &intrmask, &old);
+  intrtype = type;
+  intrsp = (unsigned long)&uc;
+
+  intrctx.uc_stack.ss_sp = intrstack_limit;
+  intrctx.uc_stack.ss_size = HOST_INTRSTACK_SIZE;
+  intrctx.uc_link = NULL;
+  intrctx.uc_sigmask = intrmask;
+  makecontext(&intrctx, host_intr_entry, 0);
+  swapcontext(&uc, &intrctx);
+
+  /*dispatch()で戻ってきたら、割り込み前のマスクに戻す*/
+  sigprocmask(SIG_SETMASK, &old, NULL);
+}
+
+/*スレッドのスタートアップ(ポインタはintに分けて渡される)*/
+static void host_start(unsigned int hi, unsigned int lo)
+{
+  host_frame *fp = (host_frame *)(uintptr_t)(((unsigned long long)hi << 32) | lo);
+
+  if(fp->intr)
+    host_intr_enable();
+  fp->func(fp->arg);
+}
+
+/*
+  スレッドの初期コンテキストを作成し、spとして保存する値を返す
+  dispatch()はどのコンテキストも割り込み禁止で復帰させ、
+  割り込みの許可はスレッドのスタック上で行う
+*/
+unsigned long host_context_init(char *stack, char *stackend,
+				void (*func)(void *), void *arg, int intr)
+{
+  host_frame *fp;
+
+  fp = (host_frame *)(((uintptr_t)stackend - sizeof(*fp)) & ~(uintptr_t)15);
+  fp->func = func;
+  fp->arg = arg;
+  fp->intr = intr;
+
+  getcontext(&fp->uc);
+  fp->uc.uc_stack.ss_sp = stack;
+  fp->uc.uc_stack.ss_size = (char *)fp - stack;
+  fp->uc.uc_link = NULL;
+  fp->uc.uc_sigmask = intrmask;
+  makecontext(&fp->uc, (void (*)(void))host_start, 2,
+	      (unsigned int)((unsigned long long)(uintptr_t)fp >> 32), (unsigned int)(uintptr_t)fp);
+
+  return (unsigned long)&fp->uc;
+}
+
+/*スレッドのディスパッチ(contextの先頭はsp)*/
+void dispatch(unsigned long *context)
+{
+  setcontext((ucontext_t *)*context);
+}
+
+/*ホストではシステムコールも割り込みと同じコンテキストを保存している*/
+void dispatch_syscall(unsigned long *context)
+{
+  setcontext((ucontext_t *)*context);
+}
@@ -0,0 +1,119 @@
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <string.h>
+#include <unistd.h>
+#include "defines.h"
+#include "intr.h"
+#include "interrupt.h"
+#include "serial.h"
+
+/*
+  ホスト用のシリアル
+  SCIの代わりに標準入出力を使う(indexは無視する)
+  受信割り込みは標準入力のSIGIOで模擬する
+*/
+
+static int recv_eof; /*標準入力が終わったら受信できない状態のままにする*/
+static unsigned char recv_buf;
+static int recv_pending = -1; /*先読みした文字(なければ-1)*/
+static int recv_intr; /*受信割り込みが許可されていれば1*/
+
+/*initiate device*/
+int serial_init(int index)
+{
+  return 0;
+}
+
+/*Can it enable send?*/
+int serial_is_send_enable(int index)
+{
+  return 1;
+}
+
+/*send one word*/
+int serial_send_byte(int index, unsigned char c)
+{
+  while(write(1, &c, 1) < 0)
+    ;
+  return 0;
+}
+
+int serial_is_recv_enable(int index)
+{
+  struct pollfd fds;
+
+  if(recv_pending >= 0)
+    return 1;
+  if(recv_eof)
+    return 0;
+
+  /*EOFでも読み出し可能になるので、1文字先読みして確かめる*/
+  fds.fd = 0;
+  fds.events = POLLIN;
+  if(poll(&fds, 1, 0) <= 0)
+    return 0;
+  if(read(0, &recv_buf, 1) != 1){
+    recv_eof = 1;
+    return 0;
+  }
+  recv_pending = recv_buf;
+  return 1;
+}
+
+unsigned char serial_recv_byte(int index)
+{
+  unsigned char c;
+
+  while(!serial_is_recv_enable(index)){
+    if(recv_eof)
+      return 0;
+  }
+  c = recv_pending;
+  recv_pending = -1;
+  return c;
+}
+
+/*標準入力には受信エラーはない*/
+int serial_recv_error(int index)
+{
+  return 0;
+}
+
+/*受信割り込み*/
+static void serial_signal(int sig)
+{
+  host_intr(SOFTVEC_TYPE_SERINTR);
+}
+
+/*is receive interrupt enabled?*/
+int serial_intr_is_recv_enable(int index)
+{
+  return recv_intr;
+}
+
+/*enable receive interrupt*/
+void serial_intr_recv_enable(int index)
+{
+  struct sigaction sa;
+
+  memset(&sa, 0, sizeof(sa));
+  sa.sa_handler = serial_signal;
+  sa.sa_flags = SA_RESTART;
+  sigemptyset(&sa.sa_mask);
+  sigaction(SIGIO, &sa, NULL);
+
+  fcntl(0, F_SETOWN, getpid());
+  fcntl(0, F_SETFL, fcntl(0, F_GETFL) | O_ASYNC);
+  recv_intr = 1;
+  /*許可する前に届いていた分は、SIGIOが来ないので割り込みを起こしておく*/
+  if(serial_is_recv_enable(index))
+    kill(getpid(), SIGIO);
+}
+
+/*disable receive interrupt*/
+void serial_intr_recv_disable(int index)
+{
+  fcntl(0, F_SETFL, fcntl(0, F_GETFL) & ~O_ASYNC);
+  recv_intr = 0;
+}
@@ -0,0 +1,161 @@
+#include <signal.h>
+#include <string.h>
+#include <sys/time.h>
+#include <time.h>
+#include "defines.h"
+#include "intr.h"
+#include "interrupt.h"
+#include "timer.h"
+
+/*
+  ホスト用のタイマ
+  H8のコンペアマッチ・タイマ(timer.c)を、モノトニック時計とsetitimer()で模擬する。
+  カウンタの単位はH8と同じ(φ/64)なので、カーネル側の計算は変わらない。
+  コンペアマッチはSIGALRMで通知され、タイマ割り込みになる
+*/
+
+#define TIMER_NSEC_PER_COUNT (1000000000 / TIMER_CLOCK_HZ) /*1カウントのナノ秒数*/
+#define TIMER_SLEEP_MAX (0x10000 / TIMER_TICK_COUNT) /*ワンショットの最大ティック数*/
+
+static unsigned long long tcnt_base; /*カウンタが0だった時刻[ns]*/
+static uint32 tcora; /*コンペアマッチの値*/
+static int cmfa; /*コンペアマッチ・フラグ*/
+
+static unsigned long long cycle_base; /*サイクル・カウンタを開始した時刻[ns]*/
+
+static unsigned long long timer_now(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (unsigned long long)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/*
+  カウンタの値を求める
+  コンペアマッチの位置を越えていればフラグを立て、カウンタをクリアする
+*/
+static uint32 timer_tcnt(void)
+{
+  unsigned long long period = (unsigned long long)(tcora + 1) * TIMER_NSEC_PER_COUNT;
+  unsigned long long elapsed = timer_now() - tcnt_base;
+
+  if(elapsed >= period){
+    tcnt_base += elapsed / period * period;
+    elapsed %= period;
+    cmfa = 1;
+  }
+  return elapsed / TIMER_NSEC_PER_COUNT;
+}
+
+/*次のコンペアマッチでSIGALRMが来るように設定する*/
+static void timer_arm(int periodic)
+{
+  struct itimerval it;
+  unsigned long long us;
+
+  /*早く来ないように切り上げる*/
+  us = ((unsigned long long)(tcora + 1 - timer_tcnt()) * TIMER_NSEC_PER_COUNT + 999) / 1000;
+  it.it_value.tv_sec = us / 1000000;
+  it.it_value.tv_usec = us % 1000000;
+  us = periodic ? (unsigned long long)(tcora + 1) * TIMER_NSEC_PER_COUNT / 1000 : 0;
+  it.it_interval.tv_sec = us / 1000000;
+  it.it_interval.tv_usec = us % 1000000;
+  setitimer(ITIMER_REAL, &it, NULL);
+}
+
+/*コンペアマッチ割り込み*/
+static void timer_signal(int sig)
+{
+  host_intr(SOFTVEC_TYPE_TIMINTR);
+}
+
+/*initiate timer, start periodic tick*/
+int timer_init(void)
+{
+  struct sigaction sa;
+
+  memset(&sa, 0, sizeof(sa));
+  sa.sa_handler = timer_signal;
+  sa.sa_flags = SA_RESTART;
+  sigemptyset(&sa.sa_mask);
+  sigaction(SIGALRM, &sa, NULL);
+
+  tcnt_base = timer_now();
+  tcora = TIMER_TICK_COUNT - 1;
+  cmfa = 0;
+  timer_arm(1);
+
+  return 0;
+}
+
+/*has compare match occurred?*/
+int timer_is_expired(void)
+{
+  timer_tcnt();
+  return cmfa;
+}
+
+/*clear compare match flag*/
+void timer_expire(void)
+{
+  cmfa = 0;
+}
+
+static uint32 timer_read(int *matchedp)
+{
+  uint32 count;
+
+  count = timer_tcnt();
+  if(cmfa)
+    count += tcora + 1;
+
+  *matchedp = cmfa;
+  return count;
+}
+
+/*stop periodic tick, one-shot after ticks (0:max)*/
+int timer_sleep(int ticks)
+{
+  if((ticks <= 0) || (ticks > TIMER_SLEEP_MAX))
+    ticks = TIMER_SLEEP_MAX;
+  timer_tcnt(); /*それまでのコンペアマッチを反映しておく*/
+  tcora = TIMER_TICK_COUNT * ticks - 1;
+  timer_arm(0);
+  return ticks;
+}
+
+/*restart periodic tick, return elapsed ticks*/
+int timer_wakeup(void)
+{
+  uint32 count;
+  int matched;
+
+  count = timer_read(&matched);
+  cmfa = 0;
+
+  tcora = TIMER_TICK_COUNT - 1;
+  tcnt_base = timer_now() - (unsigned long long)(count % TIMER_TICK_COUNT) * TIMER_NSEC_PER_COUNT;
+  timer_arm(1);
+  return count / TIMER_TICK_COUNT;
+}
+
+/*get count elapsed since the last tick handled by kernel*/
+uint32 timer_count(void)
+{
+  int matched;
+  return timer_read(&matched);
+}
+
+/*start cycle counter (nanoseconds on the host)*/
+int timer_cycle_init(void)
+{
+  cycle_base = timer_now();
+  return 0;
+}
+
+/*get cycle counter*/
+uint32 timer_cycle(void)
+{
+  return (uint32)(timer_now() - cycle_base);
+}
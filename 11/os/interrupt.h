@@ -1,20 +1,43 @@
 #ifndef _INTERRUPT_H_INCLUDE_
 #define _INTERRUPT_H_INCLUDE_
 
-extern char softvec;
-#define SOFTVEC_ADDR (&softvec)
-
 /*ソフトウェア 割り込みベクタの種別を表す型の定義*/
 typedef short softvec_type_t;
 
 /*割り込みハンドラの型の定義*/
 typedef void (*softvec_handler_t)(softvec_type_t type, unsigned long sp);
 
+#ifdef KZ_HOSTED
+/*
+  ホスト(Linux)上で動かす場合
+  割り込みはシグナル、コンテキストはucontextで模擬する(host/host.c)
+*/
+extern softvec_handler_t host_softvecs[];
+#define SOFTVECS host_softvecs
+
+#define INTR_ENABLE host_intr_enable()
+#define INTR_DISABLE host_intr_disable()
+#define INTR_SLEEP host_intr_wait()
+
+void host_intr_enable(void);
+void host_intr_disable(void);
+void host_intr_wait(void);
+void host_intr(softvec_type_t type); /*割り込み(トラップ)の発生*/
+unsigned long host_context_init(char *stack, char *stackend,
+				void (*func)(void *), void *arg, int intr);
+void host_halt(void);
+void host_exit(int status);
+#else
+extern char softvec;
+#define SOFTVEC_ADDR (&softvec)
+
 /*ソフトウェア 割り込みベクタの位置*/
 #define SOFTVECS ((softvec_handler_t *)SOFTVEC_ADDR)
 
 #define INTR_ENABLE asm volatile ("andc.b #0x3f,ccr")
 #define INTR_DISABLE asm volatile ("orc.b #0xc0,ccr")
+#define INTR_SLEEP asm volatile ("sleep")
+#endif
 
 /*ソフトウェア・割り込みベクタの初期化*/
 int softvec_init(void);
@@ -4,23 +4,75 @@
 #include "interrupt.h"
 #include "syscall.h"
 #include "memory.h"
+#include "timer.h"
+#include "trace.h"
 #include "lib.h"
 
-#define THREAD_NUM 6 /*TCBの個数*/
-#define PRIORITY_NUM 16
+#ifndef PRIORITY_NUM
+#define PRIORITY_NUM 16 /*優先度の個数(最大64)*/
+#endif
+#if PRIORITY_NUM > 64
+#error "PRIORITY_NUM must be 64 or less"
+#endif
+#define PRIORITY_GROUP_NUM ((PRIORITY_NUM + 7) / 8) /*8優先度ごとのグループ数*/
 #define THREAD_NAME_SIZE 15 /*スレッド名の最大長*/
+#define MUTEX_NUM 8 /*ミューテックスの個数*/
+#define SEM_NUM 8 /*セマフォの個数*/
+#ifndef MSGBOX_NUM
+#define MSGBOX_NUM 16 /*メッセージボックスの個数(固定の分を含む、最大256)*/
+#endif
+#if (MSGBOX_NUM > 256) || (MSGBOX_NUM < MSGBOX_ID_NUM)
+#error "MSGBOX_NUM must be between MSGBOX_ID_NUM and 256"
+#endif
+#define MSGBOX_NAME_SIZE 15 /*メッセージボックス名の最大長*/
+#if KZ_MSGPRI_NUM > 8
+#error "KZ_MSGPRI_NUM must be 8 or less"
+#endif
+#define STACK_PAINT 0xa5 /*スタックの未使用領域を塗りつぶす値*/
+#define STACK_CANARY 0xdeadbeef /*スタックの限界に置く番兵*/
+#define STACK_FRAME_SIZE (sizeof(uint32) * 9) /*thread_run()が作る初期フレーム*/
+#define STACK_MIN (sizeof(uint32) + STACK_FRAME_SIZE) /*番兵と初期フレームが入る最小のサイズ*/
+#ifdef KZ_HOSTED
+#define STACK_SCALE 64 /*ホストではucontextとシグナルのフレームの分だけスタックを広げる*/
+#endif
+
+/*割り込みスタック(リンカスクリプトで定義されている領域)*/
+extern char intrstack_limit[], intrstack[];
 
 typedef struct _kz_context{
   uint32 sp;
+  int syscall; /*システムコールで退避した軽量なコンテキストなら1*/
 }kz_context;
 
+/*待ちキュー(優先度順につなぎ、同じ優先度ではFIFO)*/
+typedef struct _kz_waitque{
+  struct _kz_thread *head;
+}kz_waitque;
+
 typedef struct _kz_thread{
-  struct _kz_thread *next; /*レディーキューへの接続に利用するnextポインタ*/
+  struct _kz_thread *next; /*レディーキューと待ちキューへの接続に利用するnextポインタ*/
   char name[THREAD_NAME_SIZE + 1]; /*スレッドの名前*/
-  int priority;
+  int priority; /*実効優先度(優先度継承で一時的に上がる)*/
+  int basepri; /*ベース優先度(kz_run(), kz_chpri()で指定された優先度)*/
+  int timeslice; /*タイムスライス(ティック数, 0ならタイムスライスしない)*/
+  int slicecount; /*タイムスライスの残りティック数*/
   char *stack; /*スレッドのスタック*/
+  char *stackarea; /*スタック領域の先頭*/
+  int stacksize; /*スタック領域のサイズ*/
+  uint16 generation; /*TCBを再利用するたびに増える世代番号(スレッドIDに含める)*/
   uint32 flags;
 #define KZ_THREAD_FLAG_READY (1 << 0)
+#define KZ_THREAD_FLAG_SLEEP (1 << 1) /*kz_sleep()によるスリープ中*/
+#define KZ_THREAD_FLAG_TIMEOUT (1 << 2) /*タイムアウト待ちキューにつながっている*/
+#define KZ_THREAD_FLAG_STATICSTACK (1 << 3) /*スタックは呼び出し元が用意した領域*/
+#define KZ_THREAD_FLAG_CALL (1 << 4) /*kz_call()の要求が受信され、応答待ち*/
+
+  struct _kz_thread *tmnext; /*タイムアウト待ちキューへの接続に利用するポインタ*/
+  int timeout; /*前のスレッドの期限からの差分(ティック数)*/
+
+  kz_waitque *waitque; /*つながっている待ちキュー*/
+  struct _kz_mutex *waitmutex; /*ロック待ちしているミューテックス*/
+  struct _kz_mutex *mutexes; /*獲得しているミューテックスのリスト*/
 
   struct { /*スレッドのスタートアップに渡すパラメータ*/
     kz_func_t func;
@@ -33,95 +85,401 @@ typedef struct _kz_thread{
     kz_syscall_param_t *param;
   } syscall;
   
+  uint32 runtime; /*累積の実行時間(タイマのカウント数)*/
+  uint32 switches; /*ディスパッチされた回数*/
+
+  kz_msgbuf callbuf; /*kz_call()の要求メッセージ(応答まで止まっているので1つで足りる)*/
+  kz_msgbuf *sendbuf; /*満杯のメッセージボックスに送信待ちしているメッセージ*/
+
   kz_context context; /*コンテキスト情報*/
   char dummy[8];
 } kz_thread;
 
-/*メッセージ・バッファ*/
-typedef struct _kz_msgbuf{
-  struct _kz_msgbox *next;
-  kz_thread *sender;
-  struct {
-    int size;
-    char *p;
-  }param;
-}kz_msgbuf;
-
 /*メッセージボックス*/
 typedef struct _kz_msgbox{
-  kz_thread *receiver;
-  kz_msgbuf *head;
-  kz_msgbuf *tail;
+  struct _kz_msgbox *next; /*空きリストへの接続に利用する*/
+  char name[MSGBOX_NAME_SIZE + 1]; /*kz_msgbox_find()で探す名前(空なら名前なし)*/
+  uint16 generation; /*再利用するたびに増える世代番号(IDに含める)*/
+  int used;
+  kz_waitque receivers; /*受信待ちのスレッド(優先度順)*/
+  kz_waitque senders; /*満杯で送信待ちのスレッド(優先度順)*/
+  struct {
+    kz_msgbuf *head;
+    kz_msgbuf *tail;
+  }bands[KZ_MSGPRI_NUM]; /*メッセージの優先度ごとのキュー*/
+  uint8 bandmap; /*メッセージのある優先度のビットマップ*/
+  int count; /*つながっているメッセージの数*/
+  int capacity; /*メッセージの最大数(0なら制限なし)*/
 
   long dummy[1];
 }kz_msgbox;
 
+/*ミューテックス(優先度継承あり)*/
+typedef struct _kz_mutex{
+  struct _kz_mutex *next; /*オーナーが獲得しているミューテックスのリスト*/
+  kz_thread *owner;
+  kz_waitque waitque; /*ロック待ちのスレッド*/
+  int used;
+}kz_mutex;
+
+/*計数セマフォ*/
+typedef struct _kz_sem{
+  int count;
+  kz_waitque waitque; /*資源待ちのスレッド*/
+  int used;
+}kz_sem;
+
 /*スレッドのレディーキュー*/
 static struct{
   kz_thread *head; /*レディーキューの先頭のエントリ*/
   kz_thread *tail; /*レディーキューの末尾のエントリ*/
 }readyque[PRIORITY_NUM];
 
+/*
+  レディーキューのビットマップ
+  優先度を8個ずつのグループに分けた2段構成とし、
+  readygrpのビットnはreadymap[n]が0でないことを示す
+*/
+static uint8 readygrp;
+static uint8 readymap[PRIORITY_GROUP_NUM];
+
 static kz_thread *current; /*カレント・スレッド*/
+static kz_thread *nextthread; /*スケジューリングせずに直接ディスパッチするスレッド*/
 static kz_thread threads[THREAD_NUM]; /*タスク・コントロール・ブロック*/
+static kz_thread *freethreads; /*空いているTCBのリスト(nextでつなぐ)*/
 static kz_handler_t handlers[SOFTVEC_TYPE_NUM]; /*割り込みハンドラ|OSが管理する割り込みハンドラ*/
-static kz_msgbox msgboxes[MSGBOX_ID_NUM];
+static kz_msgbox msgboxes[MSGBOX_NUM];
+static kz_msgbox *freemsgboxes; /*空いているメッセージボックスのリスト(nextでつなぐ)*/
+static kz_mutex mutexes[MUTEX_NUM];
+static kz_sem sems[SEM_NUM];
+static kz_waitque kmwaitque[KZMEM_POOL_MAX]; /*メモリ・プールごとの獲得待ちのスレッド*/
+static kz_thread *timeoutque; /*タイムアウト待ちキュー(デルタ・リスト)*/
+static uint32 systime; /*カーネルの時刻(ティック数)*/
+static int tickless; /*アイドル中でティックを止めている場合は1*/
+static kz_thread *idlethread; /*kz_start()で起動したアイドル・スレッド*/
+static uint32 switchtime; /*最後にカーネルに入った時刻(タイマのカウント数)*/
+static uint32 stattime; /*前回kz_getstat()した時刻*/
+static uint32 statidle; /*前回kz_getstat()したときのアイドル・スレッドの実行時間*/
 
 void dispatch(kz_context *context);
+void dispatch_syscall(kz_context *context);
+
+/*カーネルの時刻(タイマのカウント数)*/
+static uint32 kernel_time(void)
+{
+  return systime * TIMER_TICK_COUNT + timer_count();
+}
+
+/*4ビット値の最下位の1のビット位置(0の場合は未使用)*/
+static const uint8 lsb_table[16] = {
+  0, 0, 1, 0, 2, 0, 1, 0, 3, 0, 1, 0, 2, 0, 1, 0,
+};
+
+/*8ビット値の最下位の1のビット位置を表引きで求める(xは0以外)*/
+static int lsb8(uint8 x)
+{
+  if(x & 0x0f)
+    return lsb_table[x & 0x0f];
+  return lsb_table[x >> 4] + 4;
+}
+
+/*優先度のビットをビットマップに立てる*/
+static void readymap_set(int priority)
+{
+  readymap[priority >> 3] |= (1 << (priority & 7));
+  readygrp |= (1 << (priority >> 3));
+}
+
+/*優先度のビットをビットマップから落とす*/
+static void readymap_clear(int priority)
+{
+  readymap[priority >> 3] &= ~(1 << (priority & 7));
+  if(readymap[priority >> 3] == 0)
+    readygrp &= ~(1 << (priority >> 3));
+}
 
 /*
-  カレント・スレッドをレディーキューから抜き出す
-  現在のkz_thread型のcurrentをキューから削除するイメージ
+  スレッドをレディーキューから抜き出す
+  動作中のスレッドは先頭にあるので通常はすぐに見つかるが、
+  優先度継承で優先度を変える場合には途中から抜き出すこともある
 */
-static int getcurrent(void)
-{  
-  if(current == NULL){
+static int getthread(kz_thread *thp)
+{
+  kz_thread *prev = NULL;
+  kz_thread *p;
+
+  if(thp == NULL){
     return -1;
   }
 
-  if(!(current->flags & KZ_THREAD_FLAG_READY)){
+  if(!(thp->flags & KZ_THREAD_FLAG_READY)){
     /*既にない場合は無視*/
     return 1;
   }
 
-  readyque[current->priority].head = current->next;
-  if(readyque[current->priority].head == NULL){
-    readyque[current->priority].tail = NULL;
-  }
+  for(p = readyque[thp->priority].head; p != thp; p = p->next)
+    prev = p;
+
+  if(prev)
+    prev->next = thp->next;
+  else
+    readyque[thp->priority].head = thp->next;
+  if(readyque[thp->priority].tail == thp)
+    readyque[thp->priority].tail = prev;
+  if(readyque[thp->priority].head == NULL)
+    readymap_clear(thp->priority); /*キューが空になったのでビットを落とす*/
 
   /*READYビットを落とす*/
-  current->flags &= ~KZ_THREAD_FLAG_READY;
-  current->next = NULL;
-  
+  thp->flags &= ~KZ_THREAD_FLAG_READY;
+  thp->next = NULL;
+
   return 0;
 }
 
-/*カレント・スレッドをレディーキューにつなげる
-  kz_thread型であるcurrentに設定されているTCB(タスクコントロールスレッド)を後ろに！
+/*
+  カレント・スレッドをレディーキューから抜き出す
+  現在のkz_thread型のcurrentをキューから削除するイメージ
 */
-static int putcurrent(void)
+static int getcurrent(void)
 {
-  if(current == NULL){
+  return getthread(current);
+}
+
+/*スレッドをレディーキューの末尾につなげる*/
+static int putthread(kz_thread *thp)
+{
+  if(thp == NULL){
     return -1;
   }
-  if(current->flags & KZ_THREAD_FLAG_READY){
+  if(thp->flags & KZ_THREAD_FLAG_READY){
     return 1;
   }
-  
-  
-  if(readyque[current->priority].tail){
-    readyque[current->priority].tail->next = current;    
+
+  if(readyque[thp->priority].tail){
+    readyque[thp->priority].tail->next = thp;
   }else{
-    readyque[current->priority].head = current;
+    readyque[thp->priority].head = thp;
+    readymap_set(thp->priority); /*キューが空でなくなったのでビットを立てる*/
   }
-  readyque[current->priority].tail = current;
-  
+  readyque[thp->priority].tail = thp;
+
   /*READYビットを立てる*/
-  current->flags |= KZ_THREAD_FLAG_READY;
+  thp->flags |= KZ_THREAD_FLAG_READY;
 
   return 0;
 }
 
+/*カレント・スレッドをレディーキューにつなげる
+  kz_thread型であるcurrentに設定されているTCB(タスクコントロールスレッド)を後ろに！
+*/
+static int putcurrent(void)
+{
+  return putthread(current);
+}
+
+/*待ちキューにスレッドを優先度順につなげる(同じ優先度では末尾に)*/
+static void waitque_put(kz_waitque *wq, kz_thread *thp)
+{
+  kz_thread **thpp;
+
+  for(thpp = &wq->head; *thpp; thpp = &(*thpp)->next){
+    if(thp->priority < (*thpp)->priority)
+      break;
+  }
+  thp->next = *thpp;
+  *thpp = thp;
+  thp->waitque = wq;
+}
+
+/*待ちキューの先頭(最も優先度の高い)スレッドを取り出す*/
+static kz_thread *waitque_get(kz_waitque *wq)
+{
+  kz_thread *thp = wq->head;
+
+  if(thp){
+    wq->head = thp->next;
+    thp->next = NULL;
+    thp->waitque = NULL;
+  }
+  return thp;
+}
+
+/*待ちキューから指定したスレッドを外す*/
+static void waitque_remove(kz_thread *thp)
+{
+  kz_thread **thpp;
+
+  if(thp->waitque == NULL)
+    return;
+
+  for(thpp = &thp->waitque->head; *thpp != thp; thpp = &(*thpp)->next)
+    ;
+  *thpp = thp->next;
+  thp->next = NULL;
+  thp->waitque = NULL;
+}
+
+/*
+  スレッドの実効優先度を求め直す
+  ベース優先度と、獲得しているミューテックスを待っているスレッドの
+  優先度のうち最も高いものとする(優先度継承)。
+  優先度が変わった場合はレディーキューや待ちキューにつなぎ直し、
+  ミューテックス待ちならそのオーナーにも継承を伝播させる
+*/
+static void thread_repri(kz_thread *thp)
+{
+  int priority;
+  kz_mutex *mxp;
+  kz_waitque *wq;
+
+  while(thp){
+    priority = thp->basepri;
+    for(mxp = thp->mutexes; mxp; mxp = mxp->next){
+      if(mxp->waitque.head && (mxp->waitque.head->priority < priority))
+        priority = mxp->waitque.head->priority;
+    }
+    if(priority == thp->priority)
+      break;
+
+    if(thp->flags & KZ_THREAD_FLAG_READY){
+      getthread(thp);
+      thp->priority = priority;
+      putthread(thp);
+    }else if((wq = thp->waitque) != NULL){
+      waitque_remove(thp);
+      thp->priority = priority;
+      waitque_put(wq, thp);
+    }else{
+      thp->priority = priority;
+    }
+
+    thp = thp->waitmutex ? thp->waitmutex->owner : NULL;
+  }
+}
+
+/*
+  タイムアウト待ちキューにスレッドをつなげる
+  期限の近い順に並べ、各スレッドには前のスレッドの期限からの差分を持たせる
+  (デルタ・リスト)。これによりティックごとの処理は先頭の更新だけで済む
+*/
+static void timeout_add(kz_thread *thp, int ticks)
+{
+  kz_thread **thpp;
+
+  for(thpp = &timeoutque; *thpp; thpp = &(*thpp)->tmnext){
+    if(ticks < (*thpp)->timeout)
+      break;
+    ticks -= (*thpp)->timeout;
+  }
+  if(*thpp)
+    (*thpp)->timeout -= ticks;
+
+  thp->timeout = ticks;
+  thp->tmnext = *thpp;
+  *thpp = thp;
+  thp->flags |= KZ_THREAD_FLAG_TIMEOUT;
+}
+
+/*タイムアウト待ちキューからスレッドを外す(期限前に待ちが解除された場合)*/
+static void timeout_remove(kz_thread *thp)
+{
+  kz_thread **thpp;
+
+  if(!(thp->flags & KZ_THREAD_FLAG_TIMEOUT))
+    return;
+
+  for(thpp = &timeoutque; *thpp != thp; thpp = &(*thpp)->tmnext)
+    ;
+  *thpp = thp->tmnext;
+  if(*thpp)
+    (*thpp)->timeout += thp->timeout; /*残りの差分を後ろに引き継ぐ*/
+
+  thp->tmnext = NULL;
+  thp->flags &= ~KZ_THREAD_FLAG_TIMEOUT;
+}
+
+/*
+  時刻をticksだけ進め、期限の来たスレッドをレディーキューに戻す
+  (タイマ割り込みの処理から呼ばれる)
+*/
+static void msgbox_cancel(kz_thread *thp);
+
+static void timeout_expire(int ticks)
+{
+  kz_thread *thp;
+
+  while((thp = timeoutque) != NULL){
+    if(thp->timeout > ticks){
+      thp->timeout -= ticks;
+      break;
+    }
+    ticks -= thp->timeout;
+    timeoutque = thp->tmnext;
+    thp->tmnext = NULL;
+    thp->flags &= ~KZ_THREAD_FLAG_TIMEOUT;
+
+    if(thp->flags & KZ_THREAD_FLAG_SLEEP){
+      /*kz_tsleep()のタイムアウト*/
+      thp->flags &= ~KZ_THREAD_FLAG_SLEEP;
+      thp->syscall.param->un.sleep.ret = -1;
+    }else if(thp->sendbuf){
+      /*kz_tsend()のタイムアウト*/
+      msgbox_cancel(thp);
+      thp->syscall.param->un.send.ret = -1;
+    }
+    putthread(thp);
+  }
+}
+
+/*ミューテックスを解放し、最も優先度の高い待ちスレッドに直接引き渡す*/
+static void mutex_release(kz_mutex *mxp)
+{
+  kz_mutex **mxpp;
+  kz_thread *owner = mxp->owner;
+  kz_thread *thp;
+
+  for(mxpp = &owner->mutexes; *mxpp != mxp; mxpp = &(*mxpp)->next)
+    ;
+  *mxpp = mxp->next;
+  mxp->next = NULL;
+
+  thp = waitque_get(&mxp->waitque);
+  mxp->owner = thp;
+  if(thp){
+    thp->waitmutex = NULL;
+    mxp->next = thp->mutexes;
+    thp->mutexes = mxp;
+    thread_repri(thp); /*残りの待ちスレッドの優先度を継承する*/
+    putthread(thp);
+  }
+
+  /*継承していた優先度を戻す*/
+  thread_repri(owner);
+}
+
+/*
+  スレッドID
+  下位8ビットがTCBの番号、上位が世代番号。終了したスレッドのIDは
+  TCBが再利用されると世代番号が合わなくなるので無効と判定できる
+*/
+static kz_thread_id_t thread_id(kz_thread *thp)
+{
+  return ((kz_thread_id_t)thp->generation << 8) | (thp - threads);
+}
+
+/*スレッドIDからTCBを求める(無効なIDならNULL)*/
+static kz_thread *thread_lookup(kz_thread_id_t id)
+{
+  kz_thread *thp;
+
+  if((id & 0xff) >= THREAD_NUM)
+    return NULL;
+  thp = &threads[id & 0xff];
+  if(!thp->init.func || (thp->generation != (id >> 8)))
+    return NULL;
+  return thp;
+}
+
 static void thread_end(void)
 {
   kz_exit();
@@ -135,41 +493,89 @@ static void thread_init(kz_thread *thp)
 }
 
 /*システムコールの処理(kz_run():スレッドの起動*/
-static kz_thread_id_t thread_run(kz_func_t func, char *name, int priority, int stacksize, int argc, char *argv[])
+static kz_thread_id_t thread_run(kz_func_t func, char *name, int priority, int timeslice, int stacksize, char *stack, int argc, char *argv[])
 {
-  int i;
   kz_thread *thp;
+  uint16 generation;
+  uint32 flags = 0;
+#ifndef KZ_HOSTED
   uint32 *sp;
-  extern char userstack;
-  static char *thread_stack = &userstack; /*ユーザスタックに利用される領域*/
+#endif
   
-  /*空いているタスク・コントロール・ブロックを検索*/
-  for(i = 0; i < THREAD_NUM; i++){
-    thp = &threads[i];
-    if(!thp->init.func)
-      break;
+  /*空いているタスク・コントロール・ブロックを取り出す*/
+  thp = freethreads;
+  if(thp == NULL){
+    putcurrent();
+    return -1;
   }
-  if(i == THREAD_NUM)
+
+  /*
+    スタック領域を獲得(指定されていればその領域を使う)
+    スタックはロングワード単位で扱うので、指定された領域の先頭が
+    4バイト境界になければエラーとし、サイズは4バイト単位に切り捨てる
+  */
+  if(stack){
+    if((unsigned long)stack & 3){
+      putcurrent();
+      return -1;
+    }
+    stacksize &= ~3;
+    flags = KZ_THREAD_FLAG_STATICSTACK;
+  }else{
+    stacksize = (stacksize + 3) & ~3; /*kzmem_stack_alloc()と同じ丸め*/
+  }
+  /*番兵と初期フレームが入らないと、領域の外を壊す*/
+  if(stacksize < (int)STACK_MIN){
+    putcurrent();
     return -1;
+  }
+  if(!stack){
+#ifdef KZ_HOSTED
+    stacksize *= STACK_SCALE;
+#endif
+    stack = kzmem_stack_alloc(stacksize);
+    if(stack == NULL){
+      putcurrent();
+      return -1;
+    }
+  }
+  freethreads = thp->next;
 
+  generation = thp->generation;
   memset(thp, 0, sizeof(*thp));
+  thp->generation = generation;
 
   /*タスク・コントロール・ブロック*/
   strcpy(thp->name, name);
   thp->next = NULL;
   thp->priority = priority;
-  thp->flags = 0;
+  thp->basepri = priority;
+  thp->timeslice = timeslice;
+  thp->slicecount = timeslice;
+  thp->flags = flags;
   
   thp->init.func = func;
   thp->init.argc = argc;
   thp->init.argv = argv;
   
-  /*スタック領域を獲得*/
-  memset(thread_stack, 0, stacksize);
-  thread_stack += stacksize;
-  
-  thp->stack = thread_stack; /*スタックを設定*/
+  /*
+    スタック領域を初期化
+    使用量を測れるように既知の値で塗りつぶし、限界(最下位)には
+    オーバーフロー検出用の番兵を置く
+  */
+  memset(stack, STACK_PAINT, stacksize);
+  *(uint32 *)stack = STACK_CANARY;
+  thp->stackarea = stack;
+  thp->stacksize = stacksize;
   
+  thp->stack = stack + stacksize; /*スタックを設定*/
+
+#ifdef KZ_HOSTED
+  /*スタックの上端にucontextを作り、thread_init(thp)から開始させる*/
+  thp->context.sp = host_context_init(stack + sizeof(uint32), thp->stack,
+				      (void (*)(void *))thread_init, thp,
+				      priority ? 1 : 0);
+#else
   /*スタックの初期化*/
   sp = (uint32 *)thp->stack;
   *(--sp) = (uint32)thread_end;
@@ -191,6 +597,12 @@ static kz_thread_id_t thread_run(kz_func_t func, char *name, int priority, int s
   
   /*スレッドのコンテキストを設定*/
   thp->context.sp = (uint32)sp; /*スタックポインタの保存*/
+#endif
+
+  KZTRACE(kernel_time(), KZTRACE_RUN, thp - threads, priority);
+#ifdef KZ_TRACE
+  kztrace_name(thp - threads, thp->name);
+#endif
   
   /*システムコールを呼び出したスレッドをレディーキューに戻す*/
   putcurrent();
@@ -199,160 +611,922 @@ static kz_thread_id_t thread_run(kz_func_t func, char *name, int priority, int s
   current = thp;
   putcurrent();
 
-  return (kz_thread_id_t)current;
+  return thread_id(current);
+}
+
+/*システム・コールの処理(kz_exit():スレッドの終了)*/
+static int thread_exit(int quiet)
+{
+  uint16 generation;
+
+  if(!quiet){
+    puts(current->name);
+    puts("exit");
+  }
+  KZTRACE(kernel_time(), KZTRACE_EXIT, current - threads, 0);
+
+  /*獲得したままのミューテックスは解放する*/
+  while(current->mutexes)
+    mutex_release(current->mutexes);
+
+  /*
+    スタックを解放する
+    カーネルは割り込みスタックで動作しているので、ここで解放してよい
+  */
+  if(!(current->flags & KZ_THREAD_FLAG_STATICSTACK))
+    kzmem_stack_free(current->stackarea, current->stacksize);
+
+  /*世代番号を進めてTCBを空きリストに戻す(古いIDは無効になる)*/
+  generation = current->generation + 1;
+  memset(current, 0, sizeof(*current));
+  current->generation = generation ? generation : 1;
+  current->next = freethreads;
+  freethreads = current;
+  return 0;
+}
+
+static int thread_wait(void)
+{
+  putcurrent();
+  return 0;
+}
+
+/*timeoutが0ならkz_wakeup()されるまで、そうでなければ最大timeoutティックだけスリープする*/
+static int thread_sleep(int timeout)
+{
+  current->flags |= KZ_THREAD_FLAG_SLEEP;
+  if(timeout > 0)
+    timeout_add(current, timeout);
+  return 0;
+}
+
+/*スリープ中のスレッドをレディーキューに接続してウェイクアップする*/
+static int wakeup(kz_thread *thp)
+{
+  if(!(thp->flags & KZ_THREAD_FLAG_SLEEP))
+    return -1; /*スリープしていない*/
+
+  thp->flags &= ~KZ_THREAD_FLAG_SLEEP;
+  timeout_remove(thp);
+  thp->syscall.param->un.sleep.ret = 0;
+  putthread(thp);
+
+  return 0;
+}
+
+/*
+  システムコールでブロック解除したスレッドthpと、呼び出したスレッド(current)の
+  どちらを次に動かすかを、レディーキューを調べずに決める。
+  currentは動作中だったのでレディーのスレッドの中で最も優先度が高く、
+  thpがそれより高ければthpが次に動くスレッドになる。そうでなければ
+  currentが自身の優先度のレディーキューの先頭にいる(同じ優先度の
+  スレッドが他にいない)場合に限り、そのまま継続できる
+*/
+static void handoff(kz_thread *thp)
+{
+  if(thp->priority < current->priority)
+    nextthread = thp;
+  else if(readyque[current->priority].head == current)
+    nextthread = current;
+}
+
+static int thread_wakeup(kz_thread_id_t id)
+{
+  kz_thread *thp = thread_lookup(id);
+
+  /*ウェイクアップを呼び出したスレッドをレディキューに戻す*/
+  putcurrent();
+
+  if((thp == NULL) || (wakeup(thp) < 0))
+    return -1;
+  handoff(thp);
+  return 0;
+}
+
+/*指定したティック数だけスレッドを止める(kz_wakeup()では起床しない)*/
+static int thread_delay(int ticks)
+{
+  if(ticks <= 0){
+    putcurrent();
+    return 0;
+  }
+  timeout_add(current, ticks);
+  return 0;
+}
+
+/*
+  スタックの最大使用量(ハイウォーターマーク)を求める
+  塗りつぶした値が残っていない位置までが、一度は使われた領域
+*/
+static int stack_used(kz_thread *thp)
+{
+  char *p = thp->stackarea + sizeof(uint32);
+  char *end = thp->stackarea + thp->stacksize;
+
+  while((p < end) && (*p == (char)STACK_PAINT))
+    p++;
+  return end - p;
+}
+
+/*
+  割り込みスタックの下端に番兵を置く
+  起動中のスタック(bootstack)は割り込みスタックの上端を使っているので、
+  塗りつぶすのは下半分だけにする
+*/
+static void intrstack_init(void)
+{
+  memset(intrstack_limit, STACK_PAINT, (intrstack - intrstack_limit) / 2);
+  *(uint32 *)intrstack_limit = STACK_CANARY;
+}
+
+/*スタックのオーバーフローを検出したら、システムを停止する*/
+static void stack_check(kz_thread *thp)
+{
+  if((*(uint32 *)thp->stackarea == STACK_CANARY) &&
+     (thp->context.sp >= (uint32)thp->stackarea + sizeof(uint32)))
+    return;
+
+  puts(thp->name);
+  puts(" stack overflow\n");
+  kz_sysdown();
+}
+
+static int thread_stackused(kz_thread_id_t id)
+{
+  kz_thread *thp = thread_lookup(id);
+
+  putcurrent();
+  if(thp == NULL)
+    return -1;
+  return stack_used(thp);
+}
+
+/*
+  スレッドごとの実行時間とディスパッチ回数を最大num個取得する
+  CPU負荷(0.1%単位)は前回の呼び出しからの、アイドル・スレッド以外の実行時間の割合
+*/
+static int thread_getstat(kz_threadstat *stats, int num, int *loadp)
+{
+  int i, n = 0;
+  kz_thread *thp;
+  uint32 now, elapsed, idle;
+
+  putcurrent();
+
+  for(i = 0; (i < THREAD_NUM) && (n < num); i++){
+    thp = &threads[i];
+    if(!thp->init.func)
+      continue;
+    stats[n].id = thread_id(thp);
+    strcpy(stats[n].name, thp->name);
+    stats[n].priority = thp->priority;
+    stats[n].runtime = thp->runtime;
+    stats[n].switches = thp->switches;
+    stats[n].stackused = stack_used(thp);
+    n++;
+  }
+
+  if(loadp){
+    now = kernel_time();
+    elapsed = now - stattime;
+    idle = idlethread->runtime - statidle;
+    *loadp = (elapsed >= 1000) ? 1000 - (int)(idle / (elapsed / 1000)) : 0;
+    if(*loadp < 0)
+      *loadp = 0;
+    stattime = now;
+    statidle = idlethread->runtime;
+  }
+
+  return n;
+}
+
+static kz_thread_id_t thread_getid(void)
+{
+  putcurrent();
+  return thread_id(current);
+}
+
+static int thread_chpri(int priority)
+{
+  int old = current->basepri;
+  if(priority >= 0){
+    current->basepri = priority;
+    thread_repri(current); /*継承中ならその優先度は維持される*/
+  }
+
+  putcurrent();
+  return old;
+}
+
+static kz_mutex_id_t thread_mutex_create(void)
+{
+  int i;
+
+  putcurrent();
+  for(i = 0; i < MUTEX_NUM; i++){
+    if(!mutexes[i].used)
+      break;
+  }
+  if(i == MUTEX_NUM)
+    return -1;
+
+  memset(&mutexes[i], 0, sizeof(mutexes[i]));
+  mutexes[i].used = 1;
+  return i;
+}
+
+static int thread_mutex_lock(kz_mutex_id_t id)
+{
+  kz_mutex *mxp;
+
+  if((id < 0) || (id >= MUTEX_NUM) || !mutexes[id].used){
+    putcurrent();
+    return -1;
+  }
+  mxp = &mutexes[id];
+
+  if(mxp->owner == NULL){
+    /*空いているので獲得する*/
+    mxp->owner = current;
+    mxp->next = current->mutexes;
+    current->mutexes = mxp;
+    putcurrent();
+    return 0;
+  }
+  if(mxp->owner == current){
+    /*再帰的なロックはできない*/
+    putcurrent();
+    return -1;
+  }
+
+  /*ロック待ちにし、オーナーに優先度を継承させる*/
+  current->waitmutex = mxp;
+  waitque_put(&mxp->waitque, current);
+  thread_repri(mxp->owner);
+  return 0;
+}
+
+static int thread_mutex_unlock(kz_mutex_id_t id)
+{
+  kz_mutex *mxp;
+
+  if((id < 0) || (id >= MUTEX_NUM) || (mutexes[id].owner != current)){
+    putcurrent();
+    return -1;
+  }
+  mxp = &mutexes[id];
+
+  mutex_release(mxp);
+  putcurrent();
+  return 0;
+}
+
+static kz_sem_id_t thread_sem_create(int count)
+{
+  int i;
+
+  putcurrent();
+  if(count < 0)
+    return -1;
+  for(i = 0; i < SEM_NUM; i++){
+    if(!sems[i].used)
+      break;
+  }
+  if(i == SEM_NUM)
+    return -1;
+
+  memset(&sems[i], 0, sizeof(sems[i]));
+  sems[i].count = count;
+  sems[i].used = 1;
+  return i;
+}
+
+static int thread_sem_wait(kz_sem_id_t id, int try)
+{
+  kz_sem *semp;
+
+  if((id < 0) || (id >= SEM_NUM) || !sems[id].used){
+    putcurrent();
+    return -1;
+  }
+  semp = &sems[id];
+
+  if(semp->count > 0){
+    semp->count--;
+    putcurrent();
+    return 0;
+  }
+  if(try){
+    putcurrent();
+    return -1;
+  }
+
+  /*資源が返却されるまで待つ(kz_sem_post()で0が返る)*/
+  waitque_put(&semp->waitque, current);
+  return 0;
+}
+
+/*待ちスレッドがあれば最も優先度の高いものを起こし、なければ計数を増やす*/
+static void sem_signal(kz_sem *semp)
+{
+  kz_thread *thp;
+
+  thp = waitque_get(&semp->waitque);
+  if(thp)
+    putthread(thp);
+  else
+    semp->count++;
+}
+
+static int thread_sem_post(kz_sem_id_t id)
+{
+  putcurrent();
+  if((id < 0) || (id >= SEM_NUM) || !sems[id].used)
+    return -1;
+
+  sem_signal(&sems[id]);
+  return 0;
+}
+
+static void *thread_kmalloc(int size, int mode)
+{
+  void *p;
+  int index;
+
+  p = kzmem_alloc(size);
+  if(p || (mode == KZ_KMALLOC_TRY)){
+    putcurrent();
+    return p;
+  }
+  if(mode == KZ_KMALLOC_DOWN)
+    kz_sysdown();
+
+  /*どのプールにも入らない大きさは、待っても獲得できない*/
+  index = kzmem_index(size);
+  if(index < 0){
+    putcurrent();
+    return NULL;
+  }
+
+  /*同じプールのブロックが解放されるまで待つ(kmfree()で獲得した領域が返る)*/
+  waitque_put(&kmwaitque[index], current);
+  return NULL;
+}
+
+/*
+  メモリの解放
+  そのプールで獲得を待っているスレッドがいれば、解放した領域を渡して起床する
+*/
+static void kmfree(void *p)
+{
+  kz_thread *thp;
+  kz_syscall_param_t *param;
+  int index;
+
+  index = kzmem_free(p);
+  if(index < 0)
+    return;
+
+  thp = waitque_get(&kmwaitque[index]);
+  if(thp){
+    param = thp->syscall.param;
+    param->un.kmalloc.ret = kzmem_alloc(param->un.kmalloc.size);
+    putthread(thp);
+  }
+}
+
+static int thread_kmfree(char *p)
+{
+  kmfree(p);
+  putcurrent();
+  return 0;
+}
+
+static int thread_kmstat(kz_memstat *stats, int num)
+{
+  putcurrent();
+  return kzmem_getstat(stats, num);
+}
+
+
+/*メッセージボックスが満杯か*/
+static int msgbox_full(kz_msgbox *mboxp)
+{
+  return (mboxp->capacity > 0) && (mboxp->count >= mboxp->capacity);
+}
+
+static void sendmsg(kz_msgbox *mboxp, kz_msgbuf *mp)
+{
+  int pri = mp->priority;
+
+  mp->next = NULL;
+  mboxp->count++;
+
+  /*メッセージの優先度のキューの末尾に接続する*/
+  if(mboxp->bands[pri].tail){
+    mboxp->bands[pri].tail->next = mp;
+  }else{
+    mboxp->bands[pri].head = mp;
+    mboxp->bandmap |= (1 << pri);
+  }
+  mboxp->bands[pri].tail = mp;
+}
+
+/*
+  最も優先度の高いメッセージを抜き出す(メッセージがなければNULL)
+  ビットマップで優先度を求めるので、キューの長さによらず一定時間で済む
+*/
+static kz_msgbuf *msgbox_get(kz_msgbox *mboxp)
+{
+  kz_msgbuf *mp;
+  int pri;
+
+  if(mboxp->bandmap == 0)
+    return NULL;
+  pri = lsb8(mboxp->bandmap);
+
+  mp = mboxp->bands[pri].head;
+  mboxp->bands[pri].head = mp->next;
+  if(mboxp->bands[pri].head == NULL){
+    mboxp->bands[pri].tail = NULL;
+    mboxp->bandmap &= ~(1 << pri);
+  }
+  mp->next = NULL;
+  mboxp->count--;
+  return mp;
+}
+
+/*
+  満杯のメッセージボックスへの送信待ち
+  メッセージは用意した状態で持たせておき、空きができたらmsgbox_fill()でつなぐ
+*/
+static void msgbox_sendwait(kz_msgbox *mboxp, kz_msgbuf *mp, int timeout)
+{
+  current->sendbuf = mp;
+  waitque_put(&mboxp->senders, current);
+  if(timeout > 0)
+    timeout_add(current, timeout);
+}
+
+/*空きがある間、送信待ちのスレッドのメッセージを優先度順につないで送信を完了させる*/
+static void msgbox_fill(kz_msgbox *mboxp)
+{
+  kz_thread *thp;
+  kz_msgbuf *mp;
+
+  while(!msgbox_full(mboxp) && ((thp = waitque_get(&mboxp->senders)) != NULL)){
+    mp = thp->sendbuf;
+    thp->sendbuf = NULL;
+    timeout_remove(thp);
+
+    switch(thp->syscall.type){
+    case KZ_SYSCALL_TYPE_CALL:
+      break; /*送信できても応答があるまで止まったまま*/
+    case KZ_SYSCALL_TYPE_MSG_SEND:
+      thp->syscall.param->un.msg_send.ret = mp->param.size;
+      putthread(thp);
+      break;
+    default:
+      thp->syscall.param->un.send.ret = mp->param.size;
+      putthread(thp);
+      break;
+    }
+    sendmsg(mboxp, mp);
+  }
+}
+
+/*送信待ちの取り消し(kz_tsend()のタイムアウト)*/
+static void msgbox_cancel(kz_thread *thp)
+{
+  kz_msgbuf *mp = thp->sendbuf;
+
+  waitque_remove(thp);
+  thp->sendbuf = NULL;
+  if(mp->flags & KZ_MSGBUF_FLAG_KERNEL)
+    kmfree(mp);
+}
+
+/*メッセージボックスの先頭のメッセージを、スレッドthpが受信してvpに取り出す*/
+static void msgbox_take(kz_msgbox *mboxp, kz_thread *thp, kz_msgvec *vp)
+{
+  kz_msgbuf *mp;
+
+  KZTRACE(kernel_time(), KZTRACE_RECV, thp - threads, mboxp - msgboxes);
+
+  /*メッセージボックスの先頭にあるメッセージを抜き出す*/
+  mp = msgbox_get(mboxp);
+
+  vp->sender = mp->sender ? thread_id(mp->sender) : 0;
+  vp->size = mp->param.size;
+  vp->p = mp->param.p;
+
+  /*kz_call()の要求なら、受信した時点から応答を受け付ける*/
+  if(mp->flags & KZ_MSGBUF_FLAG_CALL)
+    mp->sender->flags |= KZ_THREAD_FLAG_CALL;
+
+  /*カーネルが獲得したメッセージバッファの解放*/
+  if(mp->flags & KZ_MSGBUF_FLAG_KERNEL)
+    kmfree(mp);
+
+  /*空きができたので、送信待ちのスレッドのメッセージをつなぐ*/
+  msgbox_fill(mboxp);
 }
 
-/*システム・コールの処理(kz_exit():スレッドの終了)*/
-static int thread_exit(void)
+/*メッセージボックスの先頭のメッセージを、受信待ちのスレッドthpに渡す*/
+static void recvmsg(kz_msgbox *mboxp, kz_thread *thp)
 {
-  /*本来ならスタックも解放して再利用するべきだが省略*/
-  puts(current->name);
-  puts("exit");
-  memset(current, 0, sizeof(*current));
-  return 0;
+  kz_syscall_param_t *p = thp->syscall.param;
+  kz_msgvec vec;
+
+  /*kz_recv_batch()で待っていた場合は、空のところに届いた1つだけを渡す*/
+  if(thp->syscall.type == KZ_SYSCALL_TYPE_RECV_BATCH){
+    msgbox_take(mboxp, thp, p->un.recv_batch.vec);
+    p->un.recv_batch.ret = 1;
+    return;
+  }
+
+  /*メッセージを受信するスレッドに返す値を設定する*/
+  msgbox_take(mboxp, thp, &vec);
+  p->un.recv.ret = vec.sender;
+  if(p->un.recv.sizep)
+    *(p->un.recv.sizep) = vec.size;
+
+  if(p->un.recv.pp)
+    *(p->un.recv.pp) = vec.p;
 }
 
-static int thread_wait(void)
+static void thread_intr(softvec_type_t type, unsigned long sp);
+
+
+/*
+  メッセージをメッセージボックスにつなぎ、受信待ちスレッドがいれば受信させる
+  ブロック解除した受信スレッドを返す(いなければNULL)
+*/
+static kz_thread *msgbox_put(kz_msgbox *mboxp, kz_msgbuf *mp)
 {
-  putcurrent();
-  return 0;
+  kz_thread *thp;
+
+  KZTRACE(kernel_time(), KZTRACE_SEND,
+	  mp->sender ? mp->sender - threads : KZTRACE_NOTHREAD, mboxp - msgboxes);
+  sendmsg(mboxp, mp);
+
+  /*
+    受信待ちスレッドが存在している場合には受信処理を行う
+    最も優先度の高い(同じ優先度では最も長く待っている)スレッドが受け取る
+  */
+  thp = waitque_get(&mboxp->receivers);
+  if(thp){
+    recvmsg(mboxp, thp);/*メッセージの受信処理*/
+    putthread(thp); /*受信により動作可能になったので、ブロック解除する*/
+    return thp;
+  }
+  return NULL;
 }
 
-static int thread_sleep(void)
+/*
+  メッセージボックスID
+  スレッドIDと同じく下位8ビットが番号、上位が世代番号。
+  MSGBOX_ID_NUM未満の固定のメッセージボックスは世代番号0で、削除できない
+*/
+static kz_msgbox_id_t msgbox_id(kz_msgbox *mboxp)
 {
-  return 0;
+  return ((kz_msgbox_id_t)mboxp->generation << 8) | (mboxp - msgboxes);
 }
 
-static int thread_wakeup(kz_thread_id_t id)
+/*メッセージボックスIDからメッセージボックスを求める(無効なIDならNULL)*/
+static kz_msgbox *msgbox_lookup(kz_msgbox_id_t id)
 {
-  /*ウェイクアップを呼び出したスレッドをレディキューに戻す*/
-  putcurrent();
+  kz_msgbox *mboxp;
+
+  if((id & 0xff) >= MSGBOX_NUM)
+    return NULL;
+  mboxp = &msgboxes[id & 0xff];
+  if(!mboxp->used || (mboxp->generation != (id >> 8)))
+    return NULL;
+  return mboxp;
+}
 
-  /*指定されたスレッドをレディーキューに接続してウェイクアップする*/
-  current = (kz_thread *)id;
-  putcurrent();
+/*待っているスレッドを失敗(-1)で戻す*/
+static void msgbox_abort(kz_thread *thp)
+{
+  kz_syscall_param_t *param = thp->syscall.param;
 
-  return 0;
+  switch(thp->syscall.type){
+  case KZ_SYSCALL_TYPE_RECV:
+    param->un.recv.ret = -1;
+    break;
+  case KZ_SYSCALL_TYPE_RECV_BATCH:
+    param->un.recv_batch.ret = -1;
+    break;
+  case KZ_SYSCALL_TYPE_MSG_SEND:
+    param->un.msg_send.ret = -1;
+    break;
+  case KZ_SYSCALL_TYPE_CALL:
+    param->un.call.ret = -1;
+    break;
+  default:
+    param->un.send.ret = -1;
+    break;
+  }
+  putthread(thp);
 }
 
-static kz_thread_id_t thread_getid(void)
+/*名前で使用中のメッセージボックスを探す(名前が空なら探さない)*/
+static kz_msgbox *msgbox_byname(char *name)
 {
-  putcurrent();
-  return (kz_thread_id_t)current;
+  int i;
+
+  if((name == NULL) || (name[0] == '\0'))
+    return NULL;
+  for(i = MSGBOX_ID_NUM; i < MSGBOX_NUM; i++){
+    if(msgboxes[i].used && !strcmp(msgboxes[i].name, name))
+      return &msgboxes[i];
+  }
+  return NULL;
 }
 
-static int thread_chpri(int priority)
+static kz_msgbox_id_t thread_msgbox_create(char *name)
 {
-  int old = current->priority;
-  if(priority >= 0)
-    current->priority = priority;
-  
+  kz_msgbox *mboxp;
+
   putcurrent();
-  return old;
+  if(name && (strlen(name) > MSGBOX_NAME_SIZE))
+    return -1;
+  /*同じ名前があるとkz_msgbox_find()で区別できないので作らない*/
+  if(msgbox_byname(name))
+    return -1;
+  if(freemsgboxes == NULL)
+    return -1;
+  mboxp = freemsgboxes;
+  freemsgboxes = mboxp->next;
+
+  mboxp->next = NULL;
+  mboxp->used = 1;
+  strcpy(mboxp->name, name ? name : "");
+  return msgbox_id(mboxp);
 }
 
-static void *thread_kmalloc(int size)
+/*
+  メッセージボックスの削除
+  待っているスレッドは-1で戻し、残っているメッセージは解放する。
+  kz_msg_send()で送られたバッファも所有権が移っているので解放する
+*/
+static int thread_msgbox_delete(kz_msgbox_id_t id)
 {
+  kz_msgbox *mboxp = msgbox_lookup(id);
+  kz_thread *thp;
+  kz_msgbuf *mp;
+  uint16 generation;
+
   putcurrent();
-  return kzmem_alloc(size);
+  if((mboxp == NULL) || (mboxp - msgboxes < MSGBOX_ID_NUM))
+    return -1;
+
+  while((thp = waitque_get(&mboxp->receivers)) != NULL)
+    msgbox_abort(thp);
+  while((thp = waitque_get(&mboxp->senders)) != NULL){
+    timeout_remove(thp);
+    mp = thp->sendbuf;
+    thp->sendbuf = NULL;
+    if(mp->flags & KZ_MSGBUF_FLAG_KERNEL)
+      kmfree(mp);
+    msgbox_abort(thp);
+  }
+  while((mp = msgbox_get(mboxp)) != NULL){
+    if(mp->flags & KZ_MSGBUF_FLAG_CALL)
+      msgbox_abort(mp->sender); /*受信されていない要求は応答を待たずに戻す*/
+    else
+      kmfree(mp);
+  }
+
+  generation = mboxp->generation + 1;
+  memset(mboxp, 0, sizeof(*mboxp));
+  mboxp->generation = generation ? generation : 1;
+  mboxp->next = freemsgboxes;
+  freemsgboxes = mboxp;
+  return 0;
 }
 
-static int thread_kmfree(char *p)
+/*名前からメッセージボックスIDを求める(見つからなければ-1)*/
+static kz_msgbox_id_t thread_msgbox_find(char *name)
 {
-  kzmem_free(p);
+  kz_msgbox *mboxp;
+
   putcurrent();
-  return 0;
+  mboxp = msgbox_byname(name);
+  return mboxp ? msgbox_id(mboxp) : -1;
 }
 
-
-static void sendmsg(kz_msgbox *mboxp, kz_thread *thp, int size, char *p)
+/*カーネルでメッセージのバッファを獲得する(獲得できなければNULL)*/
+static kz_msgbuf *msgbuf_alloc(kz_thread *thp, int size, char *p, int priority)
 {
   kz_msgbuf *mp;
-  
-  /*メッセージのバッファ作成*/
-  mp = (kz_msgbuf *) kzmem_alloc(sizeof(*mp));
+
+  mp = (kz_msgbuf *)kzmem_alloc(sizeof(*mp));
   if(mp == NULL)
-    kz_sysdown();
+    return NULL;
 
-  mp->next = NULL;
   mp->sender = thp;
+  mp->flags = KZ_MSGBUF_FLAG_KERNEL;
+  mp->priority = priority;
   mp->param.size = size;
   mp->param.p = p;
+  return mp;
+}
 
-  /*メッセージボックスの末尾にメッセージを接続する*/
-  if(mboxp->tail){
-    mboxp->tail->next = mp;
-  }else{
-    mboxp->head = mp;
-  }
-  mboxp->tail = mp;
+/*メッセージの優先度が正しいか*/
+static int msgpri_valid(int priority)
+{
+  return (priority >= 0) && (priority < KZ_MSGPRI_NUM);
 }
-static void recvmsg(kz_msgbox *mboxp)
+
+/*
+  kz_send(), kz_tsend(), kz_psend():メッセージボックスが満杯ならtimeoutティックまで待つ
+  (0なら空くまで待ち、負なら待たずに失敗する)
+*/
+static int thread_send(kz_msgbox_id_t id, int size, char *p, int timeout, int priority)
 {
+  kz_msgbox *mboxp = msgbox_lookup(id);
   kz_msgbuf *mp;
-  kz_syscall_param_t *p;
+  kz_thread *thp;
 
-  /*メッセージボックスの先頭にあるメッセージを抜き出す*/
-  mp = mboxp->head;
-  mboxp->head = mp->next;
-  if(mboxp->head == NULL)
-    mboxp->tail = NULL;
-  mp->next = NULL;
+  if((mboxp == NULL) || !msgpri_valid(priority) ||
+     (msgbox_full(mboxp) && (timeout < 0))){
+    putcurrent();
+    return -1;
+  }
 
-  /*メッセージを受信するスレッドに返す値を設定する*/
-  p = mboxp->receiver->syscall.param;
-  p->un.recv.ret = (kz_thread_id_t)mp->sender;
-  if(p->un.recv.sizep)
-    *(p->un.recv.sizep) = mp->param.size;
+  mp = msgbuf_alloc(current, size, p, priority);
+  if(mp == NULL){
+    putcurrent();
+    return -1; /*バッファが足りなければ失敗を返し、送信側に再送させる*/
+  }
 
-  if(p->un.recv.pp)
-    *(p->un.recv.pp) = mp->param.p;
-  
-  /*受信待ちスレッドはいなくなったので、NULLに戻す*/
-  mboxp->receiver = NULL;
+  if(msgbox_full(mboxp)){
+    msgbox_sendwait(mboxp, mp, timeout);
+    return -1; /*送信できたらmsgbox_fill()で値を設定する*/
+  }
 
-  /*メッセージバッファの解放*/
-  kzmem_free(mp);
+  putcurrent();
+  thp = msgbox_put(mboxp, mp);
+  if(thp)
+    handoff(thp);
+  return size;
 }
 
-static void thread_intr(softvec_type_t type, unsigned long sp);
+/*
+  kz_msg_alloc()で獲得した領域の送信
+  本体の直前のヘッダをそのままつなぐので、カーネルはバッファを獲得しない
+*/
+static int thread_msg_send(kz_msgbox_id_t id, int size, char *p, int priority)
+{
+  kz_msgbox *mboxp = msgbox_lookup(id);
+  kz_msgbuf *mp = (kz_msgbuf *)p - 1;
+  kz_thread *thp;
 
+  if((mboxp == NULL) || !msgpri_valid(priority)){
+    putcurrent();
+    return -1; /*バッファの所有権は送信側に残る*/
+  }
+  /*kz_msg_alloc()で獲得した領域でなければ、直前にヘッダが無いので受け付けない*/
+  if((p == NULL) || (mp->magic != KZ_MSGBUF_MAGIC)){
+    putcurrent();
+    return -1;
+  }
 
-static int thread_send(kz_msgbox_id_t id, int size, char *p)
-{
-  kz_msgbox *mboxp = &msgboxes[id];
-  
-  putcurrent();
-  sendmsg(mboxp, current, size, p);
+  mp->sender = current;
+  mp->flags = 0;
+  mp->priority = priority;
+  mp->param.size = size;
+  mp->param.p = p;
 
-  /*受信待ちスレッドが存在している場合には受信処理を行う*/
-  if(mboxp->receiver){
-    current = mboxp->receiver;
-    recvmsg(mboxp);/*メッセージの受信処理*/
-    putcurrent(); /*受信により動作可能になったので、ブロック解除する*/
+  if(msgbox_full(mboxp)){
+    msgbox_sendwait(mboxp, mp, 0);
+    return -1;
   }
+
+  putcurrent();
+  thp = msgbox_put(mboxp, mp);
+  if(thp)
+    handoff(thp);
   return size;
 }
 
-static kz_thread_id_t thread_recv(kz_msgbox_id_t id, int *sizep, char **pp)
+/*
+  kz_call():要求を送信し、応答があるまでブロックする
+  要求メッセージはTCB内のバッファを使うので、カーネルはバッファを獲得しない
+*/
+static int thread_call(kz_msgbox_id_t id, int size, char *p)
 {
-  kz_msgbox *mboxp = &msgboxes[id];
-  
-  if(mboxp->receiver)
-    kz_sysdown();
+  kz_msgbox *mboxp = msgbox_lookup(id);
+  kz_msgbuf *mp = &current->callbuf;
+  kz_thread *thp;
+
+  if(mboxp == NULL){
+    putcurrent();
+    return -1;
+  }
+
+  mp->sender = current;
+  mp->flags = KZ_MSGBUF_FLAG_CALL;
+  mp->priority = KZ_MSGPRI_DEFAULT;
+  mp->param.size = size;
+  mp->param.p = p;
 
-  /*受信待ちスレッドに設定*/
-  mboxp->receiver = current;
+  if(msgbox_full(mboxp)){
+    msgbox_sendwait(mboxp, mp, 0);
+    return -1;
+  }
+  thp = msgbox_put(mboxp, mp);
+
+  /*受信したサーバの方が優先度が高ければ、スケジューリングせずに切り替える*/
+  if(thp)
+    handoff(thp);
+  return -1; /*応答の値はkz_reply()で設定する*/
+}
+
+/*
+  kz_reply():kz_call()で応答を待っているスレッドに応答を返す
+  優先度が許せば、スケジューリングせずにクライアントに切り替える
+*/
+static int thread_reply(kz_thread_id_t id, int size, char *p)
+{
+  kz_thread *thp = thread_lookup(id);
+  kz_syscall_param_t *param;
+
+  putcurrent();
+  if((thp == NULL) || !(thp->flags & KZ_THREAD_FLAG_CALL))
+    return -1;
+
+  thp->flags &= ~KZ_THREAD_FLAG_CALL;
+  param = thp->syscall.param;
+  param->un.call.ret = size;
+  if(param->un.call.pp)
+    *(param->un.call.pp) = p;
+  putthread(thp);
+  handoff(thp);
+  return 0;
+}
+
+/*メッセージボックスの容量の設定(0なら制限なし)*/
+static int thread_msgbox_setcap(kz_msgbox_id_t id, int capacity)
+{
+  kz_msgbox *mboxp = msgbox_lookup(id);
 
-  if(mboxp->head == NULL){
-    /*メッセージボックスにメッセージが無いので、スレッドをスリープさせる*/
+  putcurrent();
+  if((mboxp == NULL) || (capacity < 0))
+    return -1;
+  mboxp->capacity = capacity;
+  msgbox_fill(mboxp); /*容量を増やした場合は送信待ちを進める*/
+  return 0;
+}
+
+static kz_thread_id_t thread_recv(kz_msgbox_id_t id, int *sizep, char **pp)
+{
+  kz_msgbox *mboxp = msgbox_lookup(id);
+
+  if(mboxp == NULL){
+    putcurrent();
     return -1;
   }
-  recvmsg(mboxp);
+  if(mboxp->bandmap == 0){
+    /*
+      メッセージボックスにメッセージが無いので、受信待ちキューにつないでスリープさせる
+      (複数のスレッドが同じメッセージボックスで待ってよい)
+    */
+    waitque_put(&mboxp->receivers, current);
+    return -1;
+  }
+  recvmsg(mboxp, current);
   putcurrent();/*メッセージを受信できたので、レディー状態にする*/
   return current->syscall.param->un.recv.ret;
 }
 
+/*
+  kz_recv_batch():メッセージボックスにあるメッセージをmax個まで一度に受信する
+  メッセージが無い場合だけブロックする
+*/
+static int thread_recv_batch(kz_msgbox_id_t id, kz_msgvec *vec, int max)
+{
+  kz_msgbox *mboxp = msgbox_lookup(id);
+  int n;
+
+  if((mboxp == NULL) || (max <= 0)){
+    putcurrent();
+    return -1;
+  }
+  if(mboxp->bandmap == 0){
+    waitque_put(&mboxp->receivers, current);
+    return -1; /*受信したらrecvmsg()で値を設定する*/
+  }
+
+  /*送信待ちのメッセージもmsgbox_fill()でつながるので、続けて受信できる*/
+  for(n = 0; (n < max) && mboxp->bandmap; n++)
+    msgbox_take(mboxp, current, &vec[n]);
+  putcurrent();
+  return n;
+}
+
 
 /*割り込みハンドラの登録*/
 static int setintr(softvec_type_t type, kz_handler_t handler)
@@ -366,23 +1540,68 @@ static int setintr(softvec_type_t type, kz_handler_t handler)
   return 0;
 }
 
+/*
+  kz_setintr():デバイス・ドライバの割り込みハンドラの登録
+  ハンドラからはkx_send()などの割り込みハンドラ用サービスコールを使う。
+  カーネルが使う割り込みは登録できない
+*/
+static int thread_setintr(softvec_type_t type, kz_handler_t handler)
+{
+  putcurrent();
+  if((type < 0) || (type >= SOFTVEC_TYPE_NUM) ||
+     (type == SOFTVEC_TYPE_SYSCALL) || (type == SOFTVEC_TYPE_SOFTERR) ||
+     (type == SOFTVEC_TYPE_TIMINTR))
+    return -1;
+  setintr(type, handler);
+  return 0;
+}
+
 /*システム・コールの処理関数の呼び出し*/
 static void call_functions(kz_syscall_type_t type, kz_syscall_param_t *p)
 {
   switch(type){
   case KZ_SYSCALL_TYPE_RUN:
     p->un.run.ret = thread_run(p->un.run.func, p->un.run.name,
-			       p->un.run.priority, p->un.run.stacksize,
+			       p->un.run.priority, p->un.run.timeslice,
+			       p->un.run.stacksize, p->un.run.stack,
 			       p->un.run.argc, p->un.run.argv);
     break;
   case KZ_SYSCALL_TYPE_EXIT:
-    thread_exit();
+    thread_exit(p->un.exit.quiet);
     break;
   case KZ_SYSCALL_TYPE_WAIT:
     p->un.wait.ret = thread_wait();
     break;
   case KZ_SYSCALL_TYPE_SLEEP:
-    p->un.sleep.ret = thread_sleep();
+    p->un.sleep.ret = thread_sleep(p->un.sleep.timeout);
+    break;
+  case KZ_SYSCALL_TYPE_MUTEX_CREATE:
+    p->un.mutex_create.ret = thread_mutex_create();
+    break;
+  case KZ_SYSCALL_TYPE_MUTEX_LOCK:
+    p->un.mutex_lock.ret = thread_mutex_lock(p->un.mutex_lock.id);
+    break;
+  case KZ_SYSCALL_TYPE_MUTEX_UNLOCK:
+    p->un.mutex_unlock.ret = thread_mutex_unlock(p->un.mutex_unlock.id);
+    break;
+  case KZ_SYSCALL_TYPE_SEM_CREATE:
+    p->un.sem_create.ret = thread_sem_create(p->un.sem_create.count);
+    break;
+  case KZ_SYSCALL_TYPE_SEM_WAIT:
+    p->un.sem_wait.ret = thread_sem_wait(p->un.sem_wait.id, p->un.sem_wait.try);
+    break;
+  case KZ_SYSCALL_TYPE_SEM_POST:
+    p->un.sem_post.ret = thread_sem_post(p->un.sem_post.id);
+    break;
+  case KZ_SYSCALL_TYPE_STACKUSED:
+    p->un.stackused.ret = thread_stackused(p->un.stackused.id);
+    break;
+  case KZ_SYSCALL_TYPE_GETSTAT:
+    p->un.getstat.ret = thread_getstat(p->un.getstat.stats, p->un.getstat.num,
+				       p->un.getstat.loadp);
+    break;
+  case KZ_SYSCALL_TYPE_DELAY:
+    p->un.delay.ret = thread_delay(p->un.delay.ticks);
     break;
   case KZ_SYSCALL_TYPE_WAKEUP:
     p->un.wakeup.ret = thread_wakeup(p->un.wakeup.id);
@@ -394,13 +1613,48 @@ static void call_functions(kz_syscall_type_t type, kz_syscall_param_t *p)
     p->un.chpri.ret = thread_chpri(p->un.chpri.priority);
     break;
   case KZ_SYSCALL_TYPE_KMALLOC:
-    p->un.kmalloc.ret = thread_kmalloc(p->un.kmalloc.size);
+    p->un.kmalloc.ret = thread_kmalloc(p->un.kmalloc.size, p->un.kmalloc.mode);
     break;
   case KZ_SYSCALL_TYPE_KMFREE:
     p->un.kmfree.ret = thread_kmfree(p->un.kmfree.p);
     break;
+  case KZ_SYSCALL_TYPE_KMSTAT:
+    p->un.kmstat.ret = thread_kmstat(p->un.kmstat.stats, p->un.kmstat.num);
+    break;
   case KZ_SYSCALL_TYPE_SEND:
-    p->un.send.ret = thread_send(p->un.send.id, p->un.send.size, p->un.send.p);
+    p->un.send.ret = thread_send(p->un.send.id, p->un.send.size, p->un.send.p,
+				 p->un.send.timeout, p->un.send.priority);
+    break;
+  case KZ_SYSCALL_TYPE_MSG_SEND:
+    p->un.msg_send.ret = thread_msg_send(p->un.msg_send.id, p->un.msg_send.size,
+					 p->un.msg_send.p, p->un.msg_send.priority);
+    break;
+  case KZ_SYSCALL_TYPE_RECV_BATCH:
+    p->un.recv_batch.ret = thread_recv_batch(p->un.recv_batch.id,
+					     p->un.recv_batch.vec,
+					     p->un.recv_batch.max);
+    break;
+  case KZ_SYSCALL_TYPE_SETINTR:
+    p->un.setintr.ret = thread_setintr(p->un.setintr.type, p->un.setintr.handler);
+    break;
+  case KZ_SYSCALL_TYPE_MSGBOX_CREATE:
+    p->un.msgbox_create.ret = thread_msgbox_create(p->un.msgbox_create.name);
+    break;
+  case KZ_SYSCALL_TYPE_MSGBOX_DELETE:
+    p->un.msgbox_delete.ret = thread_msgbox_delete(p->un.msgbox_delete.id);
+    break;
+  case KZ_SYSCALL_TYPE_MSGBOX_FIND:
+    p->un.msgbox_find.ret = thread_msgbox_find(p->un.msgbox_find.name);
+    break;
+  case KZ_SYSCALL_TYPE_MSGBOX_SETCAP:
+    p->un.msgbox_setcap.ret = thread_msgbox_setcap(p->un.msgbox_setcap.id,
+						   p->un.msgbox_setcap.capacity);
+    break;
+  case KZ_SYSCALL_TYPE_CALL:
+    p->un.call.ret = thread_call(p->un.call.id, p->un.call.size, p->un.call.p);
+    break;
+  case KZ_SYSCALL_TYPE_REPLY:
+    p->un.reply.ret = thread_reply(p->un.reply.id, p->un.reply.size, p->un.reply.p);
     break;
   case KZ_SYSCALL_TYPE_RECV:
     p->un.recv.ret = thread_recv(p->un.recv.id, p->un.recv.sizep, p->un.recv.pp);
@@ -428,20 +1682,17 @@ static void syscall_proc(kz_syscall_type_t type, kz_syscall_param_t *p)
 /*スレッドのスケジューリング*/
 static void schedule(void)
 {
-  int i;
+  int grp;
 
   /*
-   *優先度の高い順(優先度の値の小さい順)にレディー・キューを見て、
-   *動作可能なスレッドを検索する
+   *ビットマップから最も優先度の高い(値の小さい)空でない
+   *レディー・キューを求める。優先度の個数によらず一定時間で済む
    */
-  for(i = 0; i<PRIORITY_NUM; i++){
-    if(readyque[i].head) /*見つからなかった場合*/
-      break;
-  }
-  if(i == PRIORITY_NUM)
+  if(readygrp == 0) /*見つからなかった場合*/
     kz_sysdown();
 
-  current = readyque[i].head;
+  grp = lsb8(readygrp);
+  current = readyque[(grp << 3) + lsb8(readymap[grp])].head;
 }
 
 /*システムコールの呼び出し*/
@@ -450,19 +1701,107 @@ static void syscall_intr(void)
   syscall_proc(current->syscall.type, current->syscall.param);
 }
 
+/*
+  タイマ割り込み(ティック)の処理
+  タイムスライスを使い切ったスレッドを、同じ優先度のレディーキューの
+  末尾に回す(ラウンドロビン)
+*/
+static void timer_intr(void)
+{
+  /*ティックレス状態からの復帰時に処理済みの場合は何もしない*/
+  if(!timer_is_expired())
+    return;
+  timer_expire();
+  systime++;
+  timeout_expire(1);
+
+  if(!current->timeslice)
+    return;
+  if(--current->slicecount > 0)
+    return;
+  current->slicecount = current->timeslice;
+
+  /*同じ優先度に他のスレッドがいなければ回す必要はない*/
+  if((current->flags & KZ_THREAD_FLAG_READY) && current->next){
+    getcurrent();
+    putcurrent();
+  }
+}
+
 static void softerr_intr(void)
 {
   puts(current->name);
   puts("DOWN\n");
   getcurrent(); /*レディーキューから外す*/
-  thread_exit(); /*スレッドを終了する*/
+  thread_exit(0); /*スレッドを終了する*/
+}
+
+/*
+  ティックレス・アイドルの開始
+  動作可能なスレッドが1つだけなら、タイムスライスのためのティックは不要なので、
+  周期割り込みを止めて次の期限でワンショットのコンペアマッチを設定する
+*/
+static void tickless_enter(void)
+{
+  int grp = lsb8(readygrp);
+
+  if((readygrp & (readygrp - 1)) || (readymap[grp] & (readymap[grp] - 1)))
+    return; /*複数の優先度にスレッドがいる*/
+  if(current->next)
+    return; /*同じ優先度に他のスレッドがいる*/
+  if(timer_is_expired())
+    return; /*未処理のティックがある*/
+
+  /*
+    次にタイムアウトするスレッドの期限でワンショットを設定する
+    (待ちがなければ最大の間隔で時刻の更新のみ行う)
+  */
+  timer_sleep(timeoutque ? timeoutque->timeout : 0);
+  tickless = 1;
+}
+
+/*ティックレス・アイドルからの復帰(止めていた間の時刻を補正する)*/
+static void tickless_exit(void)
+{
+  int ticks = timer_wakeup();
+  systime += ticks;
+  tickless = 0;
+  timeout_expire(ticks);
 }
 
 /*割り込み処理の入り口関数*/
 static void thread_intr(softvec_type_t type, unsigned long sp)
 {
-  /*カレント・スレッドのコンテクストを保存*/
+  kz_thread *prev = current;
+  uint32 now;
+
+  /*
+    カレント・スレッドのコンテクストを保存
+    システムコールの場合はER4-ER6しか退避されていない
+  */
   current->context.sp = sp;
+  current->context.syscall = (type == SOFTVEC_TYPE_SYSCALL);
+
+  /*動作していたスレッドのスタックが限界を越えていないか調べる*/
+  stack_check(current);
+  /*前回の割り込み処理で割り込みスタックが溢れていないか調べる*/
+  if(*(uint32 *)intrstack_limit != STACK_CANARY){
+    puts("intrstack overflow\n");
+    kz_sysdown();
+  }
+
+  if(tickless)
+    tickless_exit();
+
+  /*前回カーネルに入ってからの時間を、動作していたスレッドの実行時間に加える*/
+  now = kernel_time();
+  current->runtime += now - switchtime;
+  switchtime = now;
+
+  if(type == SOFTVEC_TYPE_SYSCALL)
+    KZTRACE(now, KZTRACE_SYSCALL, current - threads, current->syscall.type);
+  else
+    KZTRACE(now, KZTRACE_INTR, current - threads, type);
 
   /*
     割り込みごとの処理を実行する
@@ -473,18 +1812,37 @@ static void thread_intr(softvec_type_t type, unsigned long sp)
   if(handlers[type])
     handlers[type]();
 
-  /*次に動作するスレッドをスケジューリング*/
-  schedule();
+  /*
+    次に動作するスレッドをスケジューリング
+    システムコールで切り替え先が決まっている場合は、スケジューリングを省略する
+  */
+  if(nextthread){
+    current = nextthread;
+    nextthread = NULL;
+  }else{
+    schedule();
+  }
+  if(current != prev){
+    current->switches++;
+    KZTRACE(kernel_time(), KZTRACE_SWITCH, current - threads, prev - threads);
+  }
+  tickless_enter();
 
   /*
     スレッドのディスパッチ
-    スケジューリングされたスレッドをディスパッチする
+    スケジューリングされたスレッドを、退避したときと同じ形式でディスパッチする
+    (割り込みで切り替えられたスレッドは全レジスタを復帰する必要がある)
    */
-  dispatch(&current->context);
+  if(current->context.syscall)
+    dispatch_syscall(&current->context);
+  else
+    dispatch(&current->context);
 }
 
 void kz_start(kz_func_t func, char *name, int priority, int stacksize, int argc, char *argv[])
 {
+  int i;
+
   kzmem_init();
   
   /*
@@ -492,18 +1850,52 @@ void kz_start(kz_func_t func, char *name, int priority, int stacksize, int argc,
     見ている場合があるので、currentをNULLに初期化しておく
    */
   current = NULL;
+  nextthread = NULL;
   
   memset(readyque, 0, sizeof(readyque));
+  readygrp = 0;
+  memset(readymap, 0, sizeof(readymap));
   memset(threads, 0, sizeof(threads));
+  freethreads = NULL;
+  for(i = THREAD_NUM - 1; i >= 0; i--){
+    threads[i].generation = 1;
+    threads[i].next = freethreads;
+    freethreads = &threads[i];
+  }
   memset(handlers, 0, sizeof(handlers));
   memset(msgboxes, 0, sizeof(msgboxes));
+  freemsgboxes = NULL;
+  for(i = MSGBOX_NUM - 1; i >= 0; i--){
+    if(i < MSGBOX_ID_NUM){
+      msgboxes[i].used = 1; /*固定のメッセージボックスは最初から使える*/
+    }else{
+      msgboxes[i].generation = 1;
+      msgboxes[i].next = freemsgboxes;
+      freemsgboxes = &msgboxes[i];
+    }
+  }
+  memset(mutexes, 0, sizeof(mutexes));
+  memset(sems, 0, sizeof(sems));
+  memset(kmwaitque, 0, sizeof(kmwaitque));
+  timeoutque = NULL;
+  systime = 0;
+  switchtime = 0;
+  stattime = 0;
+  statidle = 0;
+  tickless = 0;
+  intrstack_init();
 
   /*割り込みハンドラの登録*/
   setintr(SOFTVEC_TYPE_SYSCALL, syscall_intr);
   setintr(SOFTVEC_TYPE_SOFTERR, softerr_intr);
+  setintr(SOFTVEC_TYPE_TIMINTR, timer_intr);
 
   /*システム・コール発行付加なので直接関数を呼び出してスレッド作成する*/
-  current = (kz_thread *)thread_run(func, name, priority, stacksize, argc, argv);
+  thread_run(func, name, priority, 0, stacksize, NULL, argc, argv); /*currentに設定される*/
+  idlethread = current;
+
+  /*タイムスライス用のティックを開始(割り込みは最初のスレッドで許可される)*/
+  timer_init();
   
   /*最初のスレッドを起動*/
   dispatch(&current->context);
@@ -513,6 +1905,9 @@ void kz_start(kz_func_t func, char *name, int priority, int stacksize, int argc,
 void kz_sysdown(void)
 {
   puts("system error!\n");
+#ifdef KZ_HOSTED
+  host_halt();
+#endif
   while(1)
     ;
 }
@@ -522,6 +1917,59 @@ void kz_syscall(kz_syscall_type_t type, kz_syscall_param_t *param)
 {
   current->syscall.type = type;
   current->syscall.param = param;
-  /*トラップ割り込みの発行*/
-  asm volatile("trapa #0"); 
+  /*
+    トラップ割り込みの発行
+    カーネルはER0-ER3を保存しないので、破壊されることをコンパイラに伝える
+  */
+#ifdef KZ_HOSTED
+  host_intr(SOFTVEC_TYPE_SYSCALL);
+#else
+  asm volatile("trapa #0" : : : "er0", "er1", "er2", "er3", "memory");
+#endif
+}
+
+/*
+  割り込みハンドラ用のサービスコール
+  setintr()で登録したハンドラの中から呼び出す(スレッドからは呼ばないこと)。
+  トラップは発行せずにカーネルのキューを直接操作し、再スケジューリングは
+  ハンドラ終了後のschedule(), dispatch()にまかせる。
+  currentは割り込まれたスレッドのままで、レディーキューにつながっている
+*/
+int kx_send(kz_msgbox_id_t id, int size, char *p)
+{
+  return kx_psend(id, size, p, KZ_MSGPRI_DEFAULT);
+}
+
+/*優先度を指定した送信(異常の通知などを溜まっているメッセージより先に受信させる)*/
+int kx_psend(kz_msgbox_id_t id, int size, char *p, int priority)
+{
+  kz_msgbox *mboxp = msgbox_lookup(id);
+  kz_msgbuf *mp;
+
+  /*割り込みハンドラは待てないので、満杯なら失敗する*/
+  if((mboxp == NULL) || !msgpri_valid(priority) || msgbox_full(mboxp))
+    return -1;
+  mp = msgbuf_alloc(NULL, size, p, priority); /*送信元のスレッドはなし*/
+  if(mp == NULL)
+    return -1;
+  msgbox_put(mboxp, mp);
+  return size;
+}
+
+int kx_wakeup(kz_thread_id_t id)
+{
+  kz_thread *thp = thread_lookup(id);
+
+  if(thp == NULL)
+    return -1;
+  return wakeup(thp);
+}
+
+int kx_sem_post(kz_sem_id_t id)
+{
+  if((id < 0) || (id >= SEM_NUM) || !sems[id].used)
+    return -1;
+
+  sem_signal(&sems[id]);
+  return 0;
 }
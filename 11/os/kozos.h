@@ -4,14 +4,35 @@
 #include "defines.h"
 #include "syscall.h"
 
+#ifndef THREAD_NUM
+#define THREAD_NUM 6 /*TCBの個数(最大256)*/
+#endif
+#if THREAD_NUM > 256
+#error "THREAD_NUM must be 256 or less"
+#endif
+
 /*システムコール*/
-kz_thread_id_t kz_run(kz_func_t func, char *name, int priority, int stacksize, int argc, char *argv[]);
+kz_thread_id_t kz_run(kz_func_t func, char *name, int priority, int timeslice, int stacksize, char *stack, int argc, char *argv[]);
 void kz_exit(void);
+void kz_exit_quiet(void);
 int kz_wait(void);
 int kz_sleep(void);
+int kz_tsleep(int timeout);
+int kz_delay(int ticks);
 int kz_wakeup(kz_thread_id_t id);
 kz_thread_id_t kz_getid(void);
 int kz_chpri(int priority);
+kz_mutex_id_t kz_mutex_create(void);
+int kz_mutex_lock(kz_mutex_id_t id);
+int kz_mutex_unlock(kz_mutex_id_t id);
+kz_sem_id_t kz_sem_create(int count);
+int kz_sem_wait(kz_sem_id_t id);
+int kz_sem_trywait(kz_sem_id_t id);
+int kz_sem_post(kz_sem_id_t id);
+int kz_stackused(kz_thread_id_t id);
+int kz_getstat(kz_threadstat *stats, int num, int *loadp);
+int kz_kmstat(kz_memstat *stats, int num);
+int kz_setintr(softvec_type_t type, kz_handler_t handler);
 
 /* ライブラリ関数 */
 /*void kz_start(kz_func_t func, char *name, int stacksize, int argc, char *argv[]);*/
@@ -19,12 +40,54 @@ void kz_start(kz_func_t func, char *name, int priority, int stacksize, int argc,
 void kz_sysdown(void);
 void kz_syscall(kz_syscall_type_t type, kz_syscall_param_t *param);
 void *kz_kmalloc(int size);
+void *kz_kmalloc_try(int size);
+void *kz_kmalloc_wait(int size);
 int kz_kmfree(void *p);
 int kz_send(kz_msgbox_id_t id, int size, char *p);
+int kz_tsend(kz_msgbox_id_t id, int size, char *p, int timeout);
+int kz_trysend(kz_msgbox_id_t id, int size, char *p);
+int kz_psend(kz_msgbox_id_t id, int size, char *p, int priority);
+int kz_tpsend(kz_msgbox_id_t id, int size, char *p, int timeout, int priority);
+int kz_msgbox_setcap(kz_msgbox_id_t id, int capacity);
+kz_msgbox_id_t kz_msgbox_create(char *name);
+int kz_msgbox_delete(kz_msgbox_id_t id);
+kz_msgbox_id_t kz_msgbox_find(char *name);
 kz_thread_id_t kz_recv(kz_msgbox_id_t id, int *sizep, char **pp);
+int kz_recv_batch(kz_msgbox_id_t id, kz_msgvec *vec, int max);
+void *kz_msg_alloc(int size);
+int kz_msg_free(void *p);
+int kz_msg_send(kz_msgbox_id_t id, int size, void *p);
+int kz_msg_psend(kz_msgbox_id_t id, int size, void *p, int priority);
+int kz_call(kz_msgbox_id_t id, int size, char *p, char **pp);
+int kz_reply(kz_thread_id_t id, int size, char *p);
 
+/* 割り込みハンドラ用サービスコール */
+int kx_send(kz_msgbox_id_t id, int size, char *p);
+int kx_psend(kz_msgbox_id_t id, int size, char *p, int priority);
+int kx_wakeup(kz_thread_id_t id);
+int kx_sem_post(kz_sem_id_t id);
+
+/* システム・タスク */
+int consdrv_main(int argc, char *argv[]);
 
 int test11_1_main(int argc, char* argv[]);
 int test11_2_main(int argc, char* argv[]);
+int bench_main(int argc, char* argv[]);
+
+/* テスト(KZ_TESTでビルドしたときのみ) */
+extern kz_msgbox_id_t test_box;
+int test_check(char *name, int ok);
+void test_begin(char *name);
+kz_thread_id_t test_run(kz_func_t func, int priority);
+void test_end(void);
+int test11_3_main(int argc, char* argv[]);
+int test11_4_main(int argc, char* argv[]);
+int test11_5_main(int argc, char* argv[]);
+int test11_6_main(int argc, char* argv[]);
+int test11_7_main(int argc, char* argv[]);
+int test11_8_main(int argc, char* argv[]);
+int test11_9_main(int argc, char* argv[]);
+int test11_10_main(int argc, char* argv[]);
+int test11_11_main(int argc, char* argv[]);
 
 #endif
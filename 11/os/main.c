@@ -3,17 +3,89 @@
 #include "interrupt.h"
 #include "lib.h"
 
+#ifdef KZ_TEST
+#define TEST_PRI 2 /*テストを実行する優先度(補助スレッドは前後の優先度で動かす)*/
+#define TEST_LOWPRI 14 /*後始末で補助スレッドを動かし切るときの優先度*/
+
+kz_msgbox_id_t test_box; /*実行中のテストが使うメッセージボックス*/
+
+/*テストの判定結果を表示し、NGなら1を返す*/
+int test_check(char *name, int ok)
+{
+  puts(name);
+  puts(ok ? ": OK\n" : ": NG\n");
+  return !ok;
+}
+
+/*テストの準備(テストの名前でメッセージボックスを作る)*/
+void test_begin(char *name)
+{
+  test_box = kz_msgbox_create(name);
+}
+
+/*補助スレッドの起動(優先度をテストの前後にして、動く順番を決める)*/
+kz_thread_id_t test_run(kz_func_t func, int priority)
+{
+  return kz_run(func, "helper", priority, 0, 0x100, NULL, 0, NULL);
+}
+
+/*
+  テストの後始末
+  メッセージボックスを削除して待っている補助スレッドを戻し、
+  優先度を下げて残っている補助スレッドを終わらせる
+*/
+void test_end(void)
+{
+  kz_msgbox_delete(test_box);
+  kz_chpri(TEST_LOWPRI);
+  kz_wait();
+  kz_chpri(TEST_PRI);
+}
+
+/*テストを1つずつ呼び出して、NGの数を表示する*/
+static int test_main(int argc, char *argv[])
+{
+  static kz_func_t tests[] = {
+    test11_3_main, test11_4_main, test11_5_main, test11_6_main,
+    test11_7_main, test11_8_main, test11_9_main, test11_10_main, test11_11_main,
+  };
+  int i, ng = 0;
+
+  for(i = 0; i < sizeof(tests) / sizeof(*tests); i++)
+    ng += tests[i](0, NULL);
+
+  puts("test done: NG ");
+  putxval(ng, 0);
+  puts("\n");
+#ifdef KZ_HOSTED
+  host_exit(ng ? 1 : 0);
+#endif
+  return 0;
+}
+#endif
+
 /*システムタスクとユーザスレッドの起動*/
 static int start_threads(int argc, char *argv[])
 {
+#ifdef KZ_BENCH
+  /*ベンチマーク・スレッドの起動*/
+  kz_run(bench_main, "bench", 2, 0, 0x200, NULL, 0, NULL);
+#elif defined(KZ_TEST)
+  /*テスト・スレッドの起動*/
+  kz_run(test_main, "test", TEST_PRI, 0, 0x200, NULL, 0, NULL);
+#else
+  /*コンソール・ドライバの起動*/
+  kz_run(consdrv_main, "consdrv", 1, 0, 0x100, NULL, 0, NULL);
+
   /*コマンド処理スレッドの起動*/
-  kz_run(test11_1_main, "test11_1", 1, 0x100, 0, NULL);
-  kz_run(test11_2_main, "test11_2", 2, 0x100, 0, NULL);
+  kz_run(test11_1_main, "test11_1", 1, 0, 0x100, NULL, 0, NULL);
+  kz_run(test11_2_main, "test11_2", 2, 0, 0x100, NULL, 0, NULL);
+#endif
 
   kz_chpri(15);
   INTR_ENABLE;
   while(1){
-    asm volatile("sleep");
+    INTR_SLEEP;
   }
   return 0;
 }
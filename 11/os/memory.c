@@ -9,7 +9,7 @@
 */
 typedef struct _kzmem_block{
   struct _kzmem_block *next;
-  int size;
+  int index; /*獲得元のメモリ・プールの番号*/
 }kzmem_block;
 
 /*メモリプール*/
@@ -17,88 +17,282 @@ typedef struct _kzmem_pool{
   int size;
   int num;
   kzmem_block *free;
+  int used; /*使用中のブロック数*/
+  int peak; /*使用中のブロック数の最大値*/
+  uint32 allocs; /*獲得した回数*/
+  uint32 fails; /*空きがなく獲得に失敗した回数*/
 }kzmem_pool;
 
-/*メモリ・プールの定義*/
+/*
+  メモリ・プールの定義({ブロックのサイズ, 個数}をサイズの昇順に並べる)
+  kz_kmstat()で得たピークの使用数や失敗回数をもとに、
+  Makefileで-DKZMEM_POOLS=...として調整できる
+*/
+#ifndef KZMEM_POOLS
+#define KZMEM_POOLS {16, 8}, {32, 8}, {64, 4}
+#endif
+
 static kzmem_pool pool[] = {
-  {16, 8, NULL},  {32, 8, NULL},  {64, 4, NULL},
+  KZMEM_POOLS
 };
 
 #define MEMORY_AREA_NUM (sizeof(pool) / sizeof(*pool))
 
+/*
+  サイズからメモリ・プールを引く表
+  ヘッダを含めたブロックのサイズのKZMEM_ALIGNバイト刻みで、その刻みが入る
+  最小のプールの番号を持つ。プールのサイズはKZMEM_ALIGNの倍数に限るので、
+  表を引くだけでプールが決まる。表の大きさは最大のプールから決め、freeareaに置く
+*/
+#define KZMEM_ALIGN 8
+
+static uint8 *sizeclass;
+static int sizeclass_num;
+
+/*
+  freeareaから領域を切り出す(足りなければNULL)
+  freeareaの終わりはリンカスクリプトでuserstackの手前にしている
+*/
+static void *kzmem_area_alloc(int size)
+{
+  extern char freearea[], efreearea[]; /*リンカスクリプトで定義されている領域*/
+  static char *area = freearea;
+  char *p;
+
+  if(size > efreearea - area)
+    return NULL;
+  p = area;
+  area += size;
+  return p;
+}
+
 /*メモリプールの初期化*/
 static int kzmem_init_pool(kzmem_pool *p)
 {
   int i;
   kzmem_block *mp;
   kzmem_block **mpp;
-  
-  extern char freearea; /*リンカスクリプトで定義されている領域*/
-  static char *area = &freearea;
 
-  mp = (kzmem_block *)area;
+  mp = kzmem_area_alloc(p->size * p->num);
+  if(mp == NULL)
+    return -1;
+
   mpp = &p->free;
   for(i = 0; i < p->num; i++){
     *mpp = mp;
     memset(mp, 0, sizeof(*mp));
-    mp->size = p->size;
     mpp = &(mp->next);
     mp = (kzmem_block *)((char *)mp + p->size);
-    area += p->size;
   }
   return 0;
 }
 
+/*サイズからメモリ・プールを引く表の初期化*/
+static int kzmem_init_class(void)
+{
+  int i, n;
+
+  for(i = 0; i < MEMORY_AREA_NUM; i++){
+    if(pool[i].size % KZMEM_ALIGN)
+      return -1;
+  }
+  sizeclass_num = pool[MEMORY_AREA_NUM - 1].size / KZMEM_ALIGN;
+  sizeclass = kzmem_area_alloc(sizeclass_num);
+  if(sizeclass == NULL)
+    return -1;
+
+  for(n = 0, i = 0; n < sizeclass_num; n++){
+    while(pool[i].size < (n + 1) * KZMEM_ALIGN)
+      i++;
+    sizeclass[n] = i;
+  }
+  return 0;
+}
+
+static int kzmem_init_stack(void);
+
 int kzmem_init(void)
 {
   int i;
+
+  if(MEMORY_AREA_NUM > KZMEM_POOL_MAX)
+    kz_sysdown();
+
+  /*メモリ・プールがfreeareaに収まらなければ、userstackを壊す前に止める*/
   for(i = 0; i<MEMORY_AREA_NUM; i++){
-    kzmem_init_pool(&pool[i]);
+    if(kzmem_init_pool(&pool[i]) < 0)
+      kz_sysdown();
   }
+  if(kzmem_init_class() < 0)
+    kz_sysdown();
+  kzmem_init_stack();
   return 0;
 }
 
+/*sizeを獲得するメモリ・プールの番号(どのプールにも入らなければ-1)*/
+int kzmem_index(int size)
+{
+  int n;
+
+  if(size < 0)
+    size = 0;
+  /*先に上限を調べる(16ビットのintでは、ヘッダを足すと桁あふれして負になる)*/
+  if(size > pool[MEMORY_AREA_NUM - 1].size - (int)sizeof(kzmem_block))
+    return -1;
+  n = (size + (int)sizeof(kzmem_block) - 1) / KZMEM_ALIGN;
+  return (n < sizeclass_num) ? sizeclass[n] : -1;
+}
+
+/*メモリの獲得(大きすぎる場合やプールが空の場合はNULLを返す)*/
 void *kzmem_alloc(int size)
 {
   int i;
   kzmem_block *mp;
   kzmem_pool *p;
-  
-  for(i = 0; i<MEMORY_AREA_NUM; i++){
-    p = &pool[i];
-  
-    if(size <= p->size - sizeof(kzmem_block)){
-      if(p->free == NULL){
-	kz_sysdown();
-	return NULL;
-      }
-      /*解放済みリンクリストから領域を取得する　*/
-      mp = p->free;
-      p->free = p->free->next;
-      mp->next = NULL;
-      
-      return mp + 1;
-    }
+
+  i = kzmem_index(size);
+  if(i < 0)
+    return NULL;
+  p = &pool[i];
+
+  if(p->free == NULL){
+    p->fails++;
+    return NULL;
   }
-  
-  kz_sysdown();
-  return NULL;
+  /*解放済みリンクリストから領域を取得する　*/
+  mp = p->free;
+  p->free = p->free->next;
+  mp->next = NULL;
+  mp->index = i;
+
+  p->allocs++;
+  if(++p->used > p->peak)
+    p->peak = p->used;
+
+  return mp + 1;
 }
-void kzmem_free(void *mem)
+
+/*メモリの解放(解放したブロックのメモリ・プールの番号を返す)*/
+int kzmem_free(void *mem)
 {
-  int i;
   kzmem_block *mp;
   kzmem_pool *p;
   
   mp = ((kzmem_block *)mem - 1);
-  
-  for(i = 0; i<MEMORY_AREA_NUM; i++){
+  if((mp->index < 0) || (mp->index >= MEMORY_AREA_NUM)){
+    kz_sysdown();
+    return -1;
+  }
+
+  p = &pool[mp->index];
+  mp->next = p->free;
+  p->free = mp;
+  p->used--;
+  return mp->index;
+}
+
+/*メモリ・プールごとの統計情報を最大num個取得し、プールの数を返す*/
+int kzmem_getstat(kz_memstat *stats, int num)
+{
+  int i;
+  kzmem_pool *p;
+
+  for(i = 0; (i < num) && (i < MEMORY_AREA_NUM); i++){
     p = &pool[i];
-    if(mp->size == p->size){
-      mp->next = p->free;
-      p->free = mp;
-      return ;
+    stats[i].size = p->size;
+    stats[i].num = p->num;
+    stats[i].used = p->used;
+    stats[i].peak = p->peak;
+    stats[i].allocs = p->allocs;
+    stats[i].fails = p->fails;
+  }
+  return MEMORY_AREA_NUM;
+}
+
+/*
+  スレッドのスタック領域
+  リンカスクリプトで定義されているuserstackの領域を、アドレス順に並べた
+  空き領域のリストで管理する(ファーストフィット)。解放時には前後の
+  空き領域と結合するので、スレッドの生成と終了を繰り返しても断片化しにくい
+*/
+typedef struct _kzmem_stack{
+  struct _kzmem_stack *next;
+  int size;
+}kzmem_stack;
+
+static kzmem_stack *freestack;
+
+#define STACK_ALIGN(size) (((size) + 3) & ~3)
+
+/*
+  実際に確保するスタック領域のサイズ
+  空きリストのヘッダが入る大きさにしてから4バイト単位に丸める
+  (ヘッダより先に丸めると、H8では6バイトになり以降の領域がずれる)
+*/
+static int kzmem_stack_size(int size)
+{
+  if(size < (int)sizeof(kzmem_stack))
+    size = sizeof(kzmem_stack);
+  return STACK_ALIGN(size);
+}
+
+static int kzmem_init_stack(void)
+{
+  extern char userstack[], euserstack[]; /*リンカスクリプトで定義されている領域*/
+
+  freestack = (kzmem_stack *)userstack;
+  freestack->next = NULL;
+  freestack->size = euserstack - userstack;
+  return 0;
+}
+
+/*スタック領域の獲得(領域の先頭アドレスを返す)*/
+void *kzmem_stack_alloc(int size)
+{
+  kzmem_stack *sp;
+  kzmem_stack **spp;
+
+  size = kzmem_stack_size(size);
+
+  for(spp = &freestack; (sp = *spp) != NULL; spp = &sp->next){
+    if(sp->size < size)
+      continue;
+    if(sp->size == size){
+      *spp = sp->next;
+      return sp;
     }
+    /*空き領域の末尾から切り出す(リストのつなぎ直しが不要)*/
+    sp->size -= size;
+    return (char *)sp + sp->size;
+  }
+  return NULL;
+}
+
+/*スタック領域の解放(隣接する空き領域と結合する)*/
+void kzmem_stack_free(void *mem, int size)
+{
+  kzmem_stack *sp = mem;
+  kzmem_stack *prev = NULL;
+  kzmem_stack *next;
+
+  size = kzmem_stack_size(size);
+
+  for(next = freestack; next && ((char *)next < (char *)sp); next = next->next)
+    prev = next;
+
+  sp->size = size;
+  sp->next = next;
+  if(next && ((char *)sp + sp->size == (char *)next)){
+    sp->size += next->size;
+    sp->next = next->next;
+  }
+
+  if(prev && ((char *)prev + prev->size == (char *)sp)){
+    prev->size += sp->size;
+    prev->next = sp->next;
+  }else if(prev){
+    prev->next = sp;
+  }else{
+    freestack = sp;
   }
-  kz_sysdown();
 }
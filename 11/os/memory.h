@@ -1,8 +1,14 @@
 #ifndef _KOZOS_MEMORY_H_INCLUDE_
 #define _KOZOS_MEMORY_H_INCLUDE_
 
+#define KZMEM_POOL_MAX 8 /*メモリ・プールの最大数*/
+
 int kzmem_init(void);
+int kzmem_index(int size);
 void *kzmem_alloc(int size);
-void kzmem_free(void *mem);
+int kzmem_free(void *mem);
+int kzmem_getstat(kz_memstat *stats, int num);
+void *kzmem_stack_alloc(int size);
+void kzmem_stack_free(void *mem, int size);
 
 #endif
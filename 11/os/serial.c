@@ -104,5 +104,39 @@ unsigned char serial_recv_byte(int index)
   return c;
 }
 
+/*
+  clear receive error, drop the data
+  オーバーラン,フレーミング,パリティ・エラーのフラグは受信割り込みを
+  出し続けるので、エラーなら1を返してフラグと受信データを捨てる
+*/
+int serial_recv_error(int index)
+{
+  volatile struct h8_3069f_sci *sci = regs[index].sci;
+  uint8 errors = H8_3069F_SCI_SSR_ORER | H8_3069F_SCI_SSR_FERERS | H8_3069F_SCI_SSR_PER;
+
+  if(!(sci->ssr & errors))
+    return 0;
+  sci->ssr &= ~(errors | H8_3069F_SCI_SSR_RDRF);
+  return 1;
+}
+
+/*is receive interrupt enabled?*/
+int serial_intr_is_recv_enable(int index)
+{
+  volatile struct h8_3069f_sci *sci = regs[index].sci;
+  return (sci->scr & H8_3069F_SCI_SCR_RIE) ? 1 : 0;
+}
 
+/*enable receive interrupt*/
+void serial_intr_recv_enable(int index)
+{
+  volatile struct h8_3069f_sci *sci = regs[index].sci;
+  sci->scr |= H8_3069F_SCI_SCR_RIE;
+}
 
+/*disable receive interrupt*/
+void serial_intr_recv_disable(int index)
+{
+  volatile struct h8_3069f_sci *sci = regs[index].sci;
+  sci->scr &= ~H8_3069F_SCI_SCR_RIE;
+}
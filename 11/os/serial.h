@@ -7,6 +7,11 @@ int serial_send_byte(int index, unsigned char b); /*send one word*/
 
 int serial_is_recv_enable(int index);
 unsigned char serial_recv_byte(int index);
+int serial_recv_error(int index); /*clear receive error, drop the data*/
+
+int serial_intr_is_recv_enable(int index); /*is receive interrupt enabled?*/
+void serial_intr_recv_enable(int index); /*enable receive interrupt*/
+void serial_intr_recv_disable(int index); /*disable receive interrupt*/
 
 #endif
 
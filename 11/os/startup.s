@@ -21,3 +21,14 @@ _dispatch:
 	mov.l    @er7+,er5
 	mov.l    @er7+,er6
 	rte
+
+# システムコールで退避した軽量なコンテキスト(ER4-ER6のみ)からの復帰
+	.global _dispatch_syscall
+	.type   _dispatch_syscall,@function
+
+_dispatch_syscall:
+	mov.l    @er0,er7
+	mov.l    @er7+,er4
+	mov.l    @er7+,er5
+	mov.l    @er7+,er6
+	rte
@@ -3,7 +3,7 @@
 #include "syscall.h"
 
 /*システム・コール*/
-kz_thread_id_t kz_run(kz_func_t func, char *name, int priority, int stacksize, int argc, char *argv[])
+kz_thread_id_t kz_run(kz_func_t func, char *name, int priority, int timeslice, int stacksize, char *stack, int argc, char *argv[])
 {
   /*スタックはスレッドごとに確保されるので、パラメータ域は自動変数としてスタック上に確保する*/
   kz_syscall_param_t param;
@@ -11,7 +11,9 @@ kz_thread_id_t kz_run(kz_func_t func, char *name, int priority, int stacksize, i
   param.un.run.func = func;
   param.un.run.name = name;
   param.un.run.priority = priority;
+  param.un.run.timeslice = timeslice;
   param.un.run.stacksize = stacksize;
+  param.un.run.stack = stack; /*NULLならカーネルが獲得する*/
   param.un.run.argc = argc;
   param.un.run.argv = argv;
   /*システムコールを呼び出す*/
@@ -22,7 +24,17 @@ kz_thread_id_t kz_run(kz_func_t func, char *name, int priority, int stacksize, i
 
 void kz_exit(void)
 {
-  kz_syscall(KZ_SYSCALL_TYPE_EXIT, NULL);
+  kz_syscall_param_t param;
+  param.un.exit.quiet = 0;
+  kz_syscall(KZ_SYSCALL_TYPE_EXIT, &param);
+}
+
+/*終了メッセージを表示せずに終了する(ベンチマークで終了を計測するため)*/
+void kz_exit_quiet(void)
+{
+  kz_syscall_param_t param;
+  param.un.exit.quiet = 1;
+  kz_syscall(KZ_SYSCALL_TYPE_EXIT, &param);
 }
 
 int kz_wait(void)
@@ -33,8 +45,14 @@ int kz_wait(void)
 }
 
 int kz_sleep(void)
+{
+  return kz_tsleep(0);
+}
+
+int kz_tsleep(int timeout)
 {
   kz_syscall_param_t param;
+  param.un.sleep.timeout = timeout;
   kz_syscall(KZ_SYSCALL_TYPE_SLEEP, &param);
   return param.un.sleep.ret;
 }
@@ -67,6 +85,25 @@ void *kz_kmalloc(int size)
 {
   kz_syscall_param_t param;
   param.un.kmalloc.size = size;
+  param.un.kmalloc.mode = KZ_KMALLOC_DOWN;
+  kz_syscall(KZ_SYSCALL_TYPE_KMALLOC, &param);
+  return param.un.kmalloc.ret;
+}
+
+void *kz_kmalloc_try(int size)
+{
+  kz_syscall_param_t param;
+  param.un.kmalloc.size = size;
+  param.un.kmalloc.mode = KZ_KMALLOC_TRY;
+  kz_syscall(KZ_SYSCALL_TYPE_KMALLOC, &param);
+  return param.un.kmalloc.ret;
+}
+
+void *kz_kmalloc_wait(int size)
+{
+  kz_syscall_param_t param;
+  param.un.kmalloc.size = size;
+  param.un.kmalloc.mode = KZ_KMALLOC_WAIT;
   kz_syscall(KZ_SYSCALL_TYPE_KMALLOC, &param);
   return param.un.kmalloc.ret;
 }
@@ -80,15 +117,43 @@ int kz_kmfree(void *p)
 }
 
 int kz_send(kz_msgbox_id_t id, int size, char *p)
+{
+  return kz_tsend(id, size, p, 0);
+}
+
+/*メッセージボックスが満杯なら最大timeoutティック待って送信する(0なら空くまで待つ)*/
+int kz_tsend(kz_msgbox_id_t id, int size, char *p, int timeout)
+{
+  return kz_tpsend(id, size, p, timeout, KZ_MSGPRI_DEFAULT);
+}
+
+/*
+  優先度を指定した送信(0が最も高い)
+  メッセージボックスの中で同じ優先度のメッセージの後ろ、低い優先度のメッセージの前に入る
+*/
+int kz_psend(kz_msgbox_id_t id, int size, char *p, int priority)
+{
+  return kz_tpsend(id, size, p, 0, priority);
+}
+
+int kz_tpsend(kz_msgbox_id_t id, int size, char *p, int timeout, int priority)
 {
   kz_syscall_param_t param;
   param.un.send.id = id;
   param.un.send.size = size;
   param.un.send.p = p;
+  param.un.send.timeout = timeout;
+  param.un.send.priority = priority;
   kz_syscall(KZ_SYSCALL_TYPE_SEND, &param);
   return param.un.send.ret;
 }
 
+/*メッセージボックスが満杯なら待たずに-1を返す*/
+int kz_trysend(kz_msgbox_id_t id, int size, char *p)
+{
+  return kz_tsend(id, size, p, -1);
+}
+
 kz_thread_id_t kz_recv(kz_msgbox_id_t id, int *sizep, char **pp)
 {
   kz_syscall_param_t param;
@@ -98,3 +163,231 @@ kz_thread_id_t kz_recv(kz_msgbox_id_t id, int *sizep, char **pp)
   kz_syscall(KZ_SYSCALL_TYPE_RECV, &param);
   return param.un.recv.ret;
 }
+
+/*
+  溜まっているメッセージをmax個までvecに受信し、受信した数を返す
+  メッセージが無ければ1つ届くまで待つ
+*/
+int kz_recv_batch(kz_msgbox_id_t id, kz_msgvec *vec, int max)
+{
+  kz_syscall_param_t param;
+  param.un.recv_batch.id = id;
+  param.un.recv_batch.vec = vec;
+  param.un.recv_batch.max = max;
+  kz_syscall(KZ_SYSCALL_TYPE_RECV_BATCH, &param);
+  return param.un.recv_batch.ret;
+}
+
+int kz_delay(int ticks)
+{
+  kz_syscall_param_t param;
+  param.un.delay.ticks = ticks;
+  kz_syscall(KZ_SYSCALL_TYPE_DELAY, &param);
+  return param.un.delay.ret;
+}
+
+kz_mutex_id_t kz_mutex_create(void)
+{
+  kz_syscall_param_t param;
+  kz_syscall(KZ_SYSCALL_TYPE_MUTEX_CREATE, &param);
+  return param.un.mutex_create.ret;
+}
+
+int kz_mutex_lock(kz_mutex_id_t id)
+{
+  kz_syscall_param_t param;
+  param.un.mutex_lock.id = id;
+  kz_syscall(KZ_SYSCALL_TYPE_MUTEX_LOCK, &param);
+  return param.un.mutex_lock.ret;
+}
+
+int kz_mutex_unlock(kz_mutex_id_t id)
+{
+  kz_syscall_param_t param;
+  param.un.mutex_unlock.id = id;
+  kz_syscall(KZ_SYSCALL_TYPE_MUTEX_UNLOCK, &param);
+  return param.un.mutex_unlock.ret;
+}
+
+kz_sem_id_t kz_sem_create(int count)
+{
+  kz_syscall_param_t param;
+  param.un.sem_create.count = count;
+  kz_syscall(KZ_SYSCALL_TYPE_SEM_CREATE, &param);
+  return param.un.sem_create.ret;
+}
+
+int kz_sem_wait(kz_sem_id_t id)
+{
+  kz_syscall_param_t param;
+  param.un.sem_wait.id = id;
+  param.un.sem_wait.try = 0;
+  kz_syscall(KZ_SYSCALL_TYPE_SEM_WAIT, &param);
+  return param.un.sem_wait.ret;
+}
+
+int kz_sem_trywait(kz_sem_id_t id)
+{
+  kz_syscall_param_t param;
+  param.un.sem_wait.id = id;
+  param.un.sem_wait.try = 1;
+  kz_syscall(KZ_SYSCALL_TYPE_SEM_WAIT, &param);
+  return param.un.sem_wait.ret;
+}
+
+int kz_sem_post(kz_sem_id_t id)
+{
+  kz_syscall_param_t param;
+  param.un.sem_post.id = id;
+  kz_syscall(KZ_SYSCALL_TYPE_SEM_POST, &param);
+  return param.un.sem_post.ret;
+}
+
+int kz_stackused(kz_thread_id_t id)
+{
+  kz_syscall_param_t param;
+  param.un.stackused.id = id;
+  kz_syscall(KZ_SYSCALL_TYPE_STACKUSED, &param);
+  return param.un.stackused.ret;
+}
+
+int kz_getstat(kz_threadstat *stats, int num, int *loadp)
+{
+  kz_syscall_param_t param;
+  param.un.getstat.stats = stats;
+  param.un.getstat.num = num;
+  param.un.getstat.loadp = loadp;
+  kz_syscall(KZ_SYSCALL_TYPE_GETSTAT, &param);
+  return param.un.getstat.ret;
+}
+
+int kz_kmstat(kz_memstat *stats, int num)
+{
+  kz_syscall_param_t param;
+  param.un.kmstat.stats = stats;
+  param.un.kmstat.num = num;
+  kz_syscall(KZ_SYSCALL_TYPE_KMSTAT, &param);
+  return param.un.kmstat.ret;
+}
+
+/*
+  メッセージ用の領域の獲得
+  本体の直前にヘッダ(kz_msgbuf)の領域を確保しておき、本体を返す
+  領域が足りなければ(kz_kmalloc_try()と同様に)NULLを返す
+*/
+void *kz_msg_alloc(int size)
+{
+  kz_msgbuf *mp;
+
+  mp = kz_kmalloc_try(sizeof(*mp) + size);
+  if(mp == NULL)
+    return NULL;
+  mp->magic = KZ_MSGBUF_MAGIC;
+  return mp + 1;
+}
+
+int kz_msg_free(void *p)
+{
+  kz_msgbuf *mp = (kz_msgbuf *)p - 1;
+
+  mp->magic = 0; /*解放した領域を送信できないようにする*/
+  return kz_kmfree(mp);
+}
+
+/*
+  kz_msg_alloc()で獲得した領域の送信(カーネルはバッファを獲得しない)
+  受信側がkz_msg_free()するか再送するまで、送信側は領域に触れないこと
+*/
+int kz_msg_send(kz_msgbox_id_t id, int size, void *p)
+{
+  return kz_msg_psend(id, size, p, KZ_MSGPRI_DEFAULT);
+}
+
+int kz_msg_psend(kz_msgbox_id_t id, int size, void *p, int priority)
+{
+  kz_syscall_param_t param;
+  param.un.msg_send.id = id;
+  param.un.msg_send.size = size;
+  param.un.msg_send.p = p;
+  param.un.msg_send.priority = priority;
+  kz_syscall(KZ_SYSCALL_TYPE_MSG_SEND, &param);
+  return param.un.msg_send.ret;
+}
+
+/*
+  要求を送信して応答を待つ(応答のサイズを返し、応答の領域を*ppに設定する)
+  サーバはkz_recv()の戻り値のスレッドIDにkz_reply()で応答する
+*/
+int kz_call(kz_msgbox_id_t id, int size, char *p, char **pp)
+{
+  kz_syscall_param_t param;
+  param.un.call.id = id;
+  param.un.call.size = size;
+  param.un.call.p = p;
+  param.un.call.pp = pp;
+  kz_syscall(KZ_SYSCALL_TYPE_CALL, &param);
+  return param.un.call.ret;
+}
+
+int kz_reply(kz_thread_id_t id, int size, char *p)
+{
+  kz_syscall_param_t param;
+  param.un.reply.id = id;
+  param.un.reply.size = size;
+  param.un.reply.p = p;
+  kz_syscall(KZ_SYSCALL_TYPE_REPLY, &param);
+  return param.un.reply.ret;
+}
+
+/*
+  メッセージボックスの容量(つなげるメッセージの最大数)の設定
+  0なら制限なし。満杯になると送信側が待たされる
+*/
+int kz_msgbox_setcap(kz_msgbox_id_t id, int capacity)
+{
+  kz_syscall_param_t param;
+  param.un.msgbox_setcap.id = id;
+  param.un.msgbox_setcap.capacity = capacity;
+  kz_syscall(KZ_SYSCALL_TYPE_MSGBOX_SETCAP, &param);
+  return param.un.msgbox_setcap.ret;
+}
+
+/*
+  メッセージボックスの作成
+  nameを指定すればkz_msgbox_find()で探せる(NULLなら名前なし)。
+  使用中のメッセージボックスと同じ名前は指定できない
+*/
+kz_msgbox_id_t kz_msgbox_create(char *name)
+{
+  kz_syscall_param_t param;
+  param.un.msgbox_create.name = name;
+  kz_syscall(KZ_SYSCALL_TYPE_MSGBOX_CREATE, &param);
+  return param.un.msgbox_create.ret;
+}
+
+/*メッセージボックスの削除(待っているスレッドには-1が返る)*/
+int kz_msgbox_delete(kz_msgbox_id_t id)
+{
+  kz_syscall_param_t param;
+  param.un.msgbox_delete.id = id;
+  kz_syscall(KZ_SYSCALL_TYPE_MSGBOX_DELETE, &param);
+  return param.un.msgbox_delete.ret;
+}
+
+kz_msgbox_id_t kz_msgbox_find(char *name)
+{
+  kz_syscall_param_t param;
+  param.un.msgbox_find.name = name;
+  kz_syscall(KZ_SYSCALL_TYPE_MSGBOX_FIND, &param);
+  return param.un.msgbox_find.ret;
+}
+
+/*割り込みハンドラの登録(ハンドラからはkx_*()を呼び出す)*/
+int kz_setintr(softvec_type_t type, kz_handler_t handler)
+{
+  kz_syscall_param_t param;
+  param.un.setintr.type = type;
+  param.un.setintr.handler = handler;
+  kz_syscall(KZ_SYSCALL_TYPE_SETINTR, &param);
+  return param.un.setintr.ret;
+}
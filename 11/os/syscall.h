@@ -2,6 +2,7 @@
 #define _KOZOS_SYSCALL_H_INCLUDE_
 
 #include "defines.h"
+#include "interrupt.h"
 
 /*システム・コール番号の定義*/
 typedef enum{
@@ -16,8 +17,88 @@ typedef enum{
   KZ_SYSCALL_TYPE_KMFREE,
   KZ_SYSCALL_TYPE_SEND,
   KZ_SYSCALL_TYPE_RECV,
+  KZ_SYSCALL_TYPE_DELAY,
+  KZ_SYSCALL_TYPE_MUTEX_CREATE,
+  KZ_SYSCALL_TYPE_MUTEX_LOCK,
+  KZ_SYSCALL_TYPE_MUTEX_UNLOCK,
+  KZ_SYSCALL_TYPE_SEM_CREATE,
+  KZ_SYSCALL_TYPE_SEM_WAIT,
+  KZ_SYSCALL_TYPE_SEM_POST,
+  KZ_SYSCALL_TYPE_STACKUSED,
+  KZ_SYSCALL_TYPE_GETSTAT,
+  KZ_SYSCALL_TYPE_KMSTAT,
+  KZ_SYSCALL_TYPE_MSG_SEND,
+  KZ_SYSCALL_TYPE_CALL,
+  KZ_SYSCALL_TYPE_REPLY,
+  KZ_SYSCALL_TYPE_MSGBOX_SETCAP,
+  KZ_SYSCALL_TYPE_MSGBOX_CREATE,
+  KZ_SYSCALL_TYPE_MSGBOX_DELETE,
+  KZ_SYSCALL_TYPE_MSGBOX_FIND,
+  KZ_SYSCALL_TYPE_RECV_BATCH,
+  KZ_SYSCALL_TYPE_SETINTR,
 }kz_syscall_type_t;
 
+/*kz_getstat()で取得するスレッドの統計情報*/
+typedef struct{
+  kz_thread_id_t id;
+  char name[16];
+  int priority;
+  uint32 runtime; /*累積の実行時間(タイマのカウント数)*/
+  uint32 switches; /*ディスパッチされた回数*/
+  int stackused; /*スタックの最大使用量*/
+}kz_threadstat;
+
+/*
+  メッセージ・バッファ
+  kz_send()ではカーネルが獲得するが、kz_msg_alloc()で獲得した領域では
+  本体の直前に置かれ、kz_msg_send()はこれをそのままメッセージボックスにつなぐ
+*/
+typedef struct _kz_msgbuf{
+  struct _kz_msgbuf *next;
+  struct _kz_thread *sender;
+  uint16 flags;
+  uint16 magic; /*kz_msg_alloc()で獲得した領域ならKZ_MSGBUF_MAGIC*/
+#define KZ_MSGBUF_FLAG_KERNEL (1 << 0) /*カーネルが獲得したバッファ(受信時に解放する)*/
+#define KZ_MSGBUF_FLAG_CALL   (1 << 1) /*kz_call()の要求(送信元は応答を待っている)*/
+  int priority; /*メッセージの優先度(小さいほど先に受信される)*/
+  struct {
+    int size;
+    char *p;
+  }param;
+}kz_msgbuf;
+
+#define KZ_MSGBUF_MAGIC 0x6d62 /*kz_msg_send()が受け付ける領域の印*/
+
+/*kz_recv_batch()で受信したメッセージ*/
+typedef struct {
+  kz_thread_id_t sender; /*送信元のスレッドID(割り込みハンドラからなら0)*/
+  int size;
+  char *p;
+}kz_msgvec;
+
+/*
+  メッセージの優先度の数(最大8)
+  メッセージボックスは優先度ごとにキューを持ち、同じ優先度ではFIFOで受信される。
+  優先度を指定しない送信は最も低い優先度になる
+*/
+#define KZ_MSGPRI_NUM 4
+#define KZ_MSGPRI_DEFAULT (KZ_MSGPRI_NUM - 1)
+
+/*kz_kmalloc()系でメモリを獲得できない場合の動作*/
+#define KZ_KMALLOC_DOWN 0 /*システムを停止する(kz_kmalloc())*/
+#define KZ_KMALLOC_TRY  1 /*NULLを返す(kz_kmalloc_try())*/
+#define KZ_KMALLOC_WAIT 2 /*解放されるまで待つ(kz_kmalloc_wait())*/
+
+/*kz_kmstat()で取得するメモリ・プールの統計情報*/
+typedef struct{
+  int size; /*ブロックのサイズ(ヘッダを含む)*/
+  int num; /*ブロックの個数*/
+  int used; /*使用中のブロック数*/
+  int peak; /*使用中のブロック数の最大値*/
+  uint32 allocs; /*獲得した回数*/
+  uint32 fails; /*空きがなく獲得に失敗した回数*/
+}kz_memstat;
+
 /*システム・コール呼び出し時のパラメータ格納域の定義*/
 typedef struct{
   union{
@@ -25,18 +106,21 @@ typedef struct{
       kz_func_t func;
       char *name;
       int priority;
+      int timeslice;
       int stacksize;
+      char *stack;
       int argc;
       char **argv;
       kz_thread_id_t ret;
     }run;
     struct {
-      int dummy;
+      int quiet; /*終了メッセージを表示しないなら1*/
     }exit;
     struct {
       int ret;
     }wait;
     struct {
+      int timeout;
       int ret;
     }sleep;
     struct {
@@ -52,6 +136,7 @@ typedef struct{
     }chpri;
     struct {
       int size;
+      int mode; /*KZ_KMALLOC_**/
       void *ret;
     }kmalloc;
     struct {
@@ -62,6 +147,8 @@ typedef struct{
       kz_msgbox_id_t id;
       int size;
       char *p;
+      int timeout; /*満杯の場合に待つティック数(0:無限, 負:待たない)*/
+      int priority; /*メッセージの優先度*/
       int ret;
     }send;
     struct {
@@ -70,6 +157,97 @@ typedef struct{
       char **pp;
       kz_thread_id_t ret;
     } recv;
+    struct {
+      kz_msgbox_id_t id;
+      int size;
+      char *p;
+      int priority;
+      int ret;
+    }msg_send;
+    struct {
+      kz_msgbox_id_t id;
+      int size;
+      char *p;
+      char **pp;
+      int ret;
+    }call;
+    struct {
+      kz_thread_id_t id;
+      int size;
+      char *p;
+      int ret;
+    }reply;
+    struct {
+      kz_msgbox_id_t id;
+      int capacity;
+      int ret;
+    }msgbox_setcap;
+    struct {
+      char *name;
+      kz_msgbox_id_t ret;
+    }msgbox_create;
+    struct {
+      kz_msgbox_id_t id;
+      int ret;
+    }msgbox_delete;
+    struct {
+      char *name;
+      kz_msgbox_id_t ret;
+    }msgbox_find;
+    struct {
+      kz_msgbox_id_t id;
+      kz_msgvec *vec;
+      int max;
+      int ret;
+    }recv_batch;
+    struct {
+      softvec_type_t type;
+      kz_handler_t handler;
+      int ret;
+    }setintr;
+    struct {
+      int ticks;
+      int ret;
+    }delay;
+    struct {
+      kz_mutex_id_t ret;
+    }mutex_create;
+    struct {
+      kz_mutex_id_t id;
+      int ret;
+    }mutex_lock;
+    struct {
+      kz_mutex_id_t id;
+      int ret;
+    }mutex_unlock;
+    struct {
+      int count;
+      kz_sem_id_t ret;
+    }sem_create;
+    struct {
+      kz_sem_id_t id;
+      int try;
+      int ret;
+    }sem_wait;
+    struct {
+      kz_sem_id_t id;
+      int ret;
+    }sem_post;
+    struct {
+      kz_thread_id_t id;
+      int ret;
+    }stackused;
+    struct {
+      kz_threadstat *stats;
+      int num;
+      int *loadp;
+      int ret;
+    }getstat;
+    struct {
+      kz_memstat *stats;
+      int num;
+      int ret;
+    }kmstat;
   } un;
 }kz_syscall_param_t;
 
@@ -0,0 +1,74 @@
+#include "defines.h"
+#include "kozos.h"
+#include "lib.h"
+
+/*
+  メッセージの優先度
+  受信は優先度(0が最高)の高い順で、同じ優先度の中では送信順になる。
+  溜まっているメッセージより後に送っても、優先度が高ければ先に受信される
+  (ホストではカーネルのメッセージ・バッファが4個なので、一度に4個まで)
+*/
+
+static char *test11_10_msg(char *s)
+{
+  char *p = kz_msg_alloc(3);
+  strcpy(p, s);
+  return p;
+}
+
+/*num個受信して、expectsの順に届いたかを調べる*/
+static int test11_10_recv(int num, char **expects, int msgfree)
+{
+  int i, size, ok = 1;
+  char *p;
+
+  for(i = 0; i < num; i++){
+    kz_recv(test_box, &size, &p);
+    if(strcmp(p, expects[i]))
+      ok = 0;
+    if(msgfree)
+      kz_msg_free(p);
+  }
+  return ok;
+}
+
+int test11_10_main(int argc, char *argv[])
+{
+  static char *expects[] = { "c1", "m1", "d1", "d2" };
+  static char *overtake[] = { "c2", "d2" };
+  int ng = 0;
+  char *p;
+
+  test_begin("test11_10");
+
+  ng += test_check("test11_10 bad priority",
+		   kz_psend(test_box, 3, "mx", KZ_MSGPRI_NUM) < 0);
+  p = test11_10_msg("mx");
+  ng += test_check("test11_10 msg bad priority",
+		   kz_msg_psend(test_box, 3, p, -1) < 0);
+  kz_msg_free(p); /*失敗した送信では所有権は送信側に残る*/
+
+  /*カーネルがバッファを獲得する送信*/
+  kz_send(test_box, 3, "d1");
+  kz_psend(test_box, 3, "m1", 1);
+  kz_send(test_box, 3, "d2");
+  kz_psend(test_box, 3, "c1", 0);
+  ng += test_check("test11_10 send order", test11_10_recv(4, expects, 0));
+
+  /*kz_msg_alloc()で獲得した領域の送信*/
+  kz_msg_send(test_box, 3, test11_10_msg("d1"));
+  kz_msg_psend(test_box, 3, test11_10_msg("c1"), 0);
+  kz_msg_psend(test_box, 3, test11_10_msg("m1"), 1);
+  kz_msg_psend(test_box, 3, test11_10_msg("d2"), KZ_MSGPRI_DEFAULT);
+  ng += test_check("test11_10 msg_send order", test11_10_recv(4, expects, 1));
+
+  /*受信の途中で送った高い優先度のメッセージが、残りを追い越す*/
+  kz_send(test_box, 3, "d1");
+  kz_send(test_box, 3, "d2");
+  ng += test_check("test11_10 overtake first", test11_10_recv(1, expects + 2, 0));
+  kz_psend(test_box, 3, "c2", 0);
+  ng += test_check("test11_10 overtake", test11_10_recv(2, overtake, 0));
+
+  test_end();
+  return ng;
+}
@@ -0,0 +1,67 @@
+#include "defines.h"
+#include "kozos.h"
+#include "lib.h"
+
+/*
+  kz_recv_batch()による一括受信
+  溜まっているメッセージを優先度順にmax個まで受け取り、無ければ1つ届くまで待つ。
+  容量が満杯で待っていた送信のメッセージも、続けて受け取れる
+*/
+
+/*メッセージを1つ送る(優先度で、テストより先に動くか後に動くかを決める)*/
+static int test11_11_send(int argc, char *argv[])
+{
+  kz_send(test_box, 3, "m4");
+  return 0;
+}
+
+static int test11_11_match(kz_msgvec *vec, int num, char **expects)
+{
+  int i;
+
+  for(i = 0; i < num; i++){
+    if(strcmp(vec[i].p, expects[i]))
+      return 0;
+  }
+  return 1;
+}
+
+int test11_11_main(int argc, char *argv[])
+{
+  static char *expects[] = { "m3", "m1", "m2" };
+  static char *filled[] = { "m1", "m2", "m4" };
+  int ng = 0;
+  kz_thread_id_t sender;
+  kz_msgvec vec[4];
+
+  test_begin("test11_11");
+
+  ng += test_check("test11_11 max 0", kz_recv_batch(test_box, vec, 0) < 0);
+  ng += test_check("test11_11 bad id", kz_recv_batch(-1, vec, 4) < 0);
+
+  kz_send(test_box, 3, "m1");
+  kz_send(test_box, 3, "m2");
+  kz_psend(test_box, 3, "m3", 0);
+  ng += test_check("test11_11 batch max", kz_recv_batch(test_box, vec, 2) == 2);
+  ng += test_check("test11_11 batch order", test11_11_match(vec, 2, expects));
+  ng += test_check("test11_11 batch sender", vec[0].sender == kz_getid());
+  ng += test_check("test11_11 batch rest", kz_recv_batch(test_box, vec, 4) == 1);
+  ng += test_check("test11_11 batch order", test11_11_match(vec, 1, expects + 2));
+
+  /*空なら送信されるまで待つ*/
+  sender = test_run(test11_11_send, 3);
+  ng += test_check("test11_11 batch wait", kz_recv_batch(test_box, vec, 4) == 1);
+  ng += test_check("test11_11 batch wait msg", !strcmp(vec[0].p, "m4"));
+  ng += test_check("test11_11 batch wait sender", vec[0].sender == sender);
+
+  /*満杯で待っている送信も、同じ呼び出しで受け取る*/
+  kz_msgbox_setcap(test_box, 2);
+  kz_send(test_box, 3, "m1");
+  kz_send(test_box, 3, "m2");
+  test_run(test11_11_send, 1);
+  ng += test_check("test11_11 batch filled", kz_recv_batch(test_box, vec, 4) == 3);
+  ng += test_check("test11_11 batch filled order", test11_11_match(vec, 3, filled));
+
+  test_end();
+  return ng;
+}
@@ -0,0 +1,48 @@
+#include "defines.h"
+#include "kozos.h"
+#include "lib.h"
+
+/*
+  容量を制限したメッセージボックスへの送信
+  満杯ならkz_trysend()は待たずに失敗し、kz_tsend()はタイムアウトし、
+  kz_send()は受信で空きができるまで待たされる
+*/
+
+static char *received;
+
+/*1つだけ受信して終わる(テストより優先度が低い)*/
+static int test11_3_recv(int argc, char *argv[])
+{
+  int size;
+
+  kz_recv(test_box, &size, &received);
+  return 0;
+}
+
+int test11_3_main(int argc, char *argv[])
+{
+  int size, ng = 0;
+  char *p;
+
+  test_begin("test11_3");
+  kz_msgbox_setcap(test_box, 2);
+
+  ng += test_check("test11_3 trysend", kz_trysend(test_box, 3, "m1") == 3);
+  ng += test_check("test11_3 trysend", kz_trysend(test_box, 3, "m2") == 3);
+  ng += test_check("test11_3 trysend full", kz_trysend(test_box, 3, "mx") < 0);
+  ng += test_check("test11_3 tsend timeout", kz_tsend(test_box, 3, "mx", 2) < 0);
+
+  /*受信するスレッドが動くまで送信側が待たされる*/
+  received = NULL;
+  test_run(test11_3_recv, 3);
+  ng += test_check("test11_3 send blocked", kz_send(test_box, 3, "m3") == 3);
+  ng += test_check("test11_3 recv first", received && !strcmp(received, "m1"));
+
+  kz_recv(test_box, &size, &p);
+  ng += test_check("test11_3 recv order", !strcmp(p, "m2"));
+  kz_recv(test_box, &size, &p);
+  ng += test_check("test11_3 recv order", !strcmp(p, "m3"));
+
+  test_end();
+  return ng;
+}
@@ -0,0 +1,91 @@
+#include "defines.h"
+#include "kozos.h"
+#include "lib.h"
+
+/*
+  優先度継承ミューテックス
+  ロックを待つスレッドの優先度を持ち主が継承し、解放するたびに
+  残りの待ちスレッドの優先度(いなければベース優先度)に戻る。
+  待ちスレッドは優先度の高い順にロックを獲得する
+*/
+
+static kz_mutex_id_t mutex1, mutex2;
+static char order[4]; /*ロックを獲得した補助スレッドの順番*/
+static int ordernum;
+
+/*自分の現在の優先度*/
+static int test11_4_priority(void)
+{
+  kz_threadstat stats[THREAD_NUM];
+  kz_thread_id_t id = kz_getid();
+  int i, num;
+
+  num = kz_getstat(stats, THREAD_NUM, NULL);
+  for(i = 0; i < num; i++){
+    if(stats[i].id == id)
+      return stats[i].priority;
+  }
+  return -1;
+}
+
+static void test11_4_lock(kz_mutex_id_t id, char c)
+{
+  kz_mutex_lock(id);
+  order[ordernum++] = c;
+  kz_mutex_unlock(id);
+}
+
+static int test11_4_lock1a(int argc, char *argv[])
+{
+  test11_4_lock(mutex1, 'a');
+  return 0;
+}
+
+static int test11_4_lock1b(int argc, char *argv[])
+{
+  test11_4_lock(mutex1, 'b');
+  return 0;
+}
+
+static int test11_4_lock2(int argc, char *argv[])
+{
+  test11_4_lock(mutex2, 'c');
+  return 0;
+}
+
+int test11_4_main(int argc, char *argv[])
+{
+  int base, ng = 0;
+
+  test_begin("test11_4");
+  mutex1 = kz_mutex_create();
+  mutex2 = kz_mutex_create();
+  base = test11_4_priority();
+
+  /*入れ子のロック:待ちスレッドの優先度を継承し、解放の順に戻る*/
+  ordernum = 0;
+  kz_mutex_lock(mutex1);
+  kz_mutex_lock(mutex2);
+  test_run(test11_4_lock1a, base - 1);
+  ng += test_check("test11_4 boost", test11_4_priority() == base - 1);
+  test_run(test11_4_lock2, base - 2);
+  ng += test_check("test11_4 nested boost", test11_4_priority() == base - 2);
+  kz_mutex_unlock(mutex2);
+  ng += test_check("test11_4 restore inner", test11_4_priority() == base - 1);
+  kz_mutex_unlock(mutex1);
+  ng += test_check("test11_4 restore base", test11_4_priority() == base);
+  ng += test_check("test11_4 nested order", (ordernum == 2) && !strncmp(order, "ca", 2));
+
+  /*待ちスレッドは起動した順ではなく優先度の順にロックを獲得する*/
+  ordernum = 0;
+  kz_mutex_lock(mutex1);
+  test_run(test11_4_lock1a, base - 1);
+  test_run(test11_4_lock1b, base - 2);
+  ng += test_check("test11_4 highest boost", test11_4_priority() == base - 2);
+  kz_mutex_unlock(mutex1);
+  ng += test_check("test11_4 wake order", (ordernum == 2) && !strncmp(order, "ba", 2));
+  ng += test_check("test11_4 restore", test11_4_priority() == base);
+
+  test_end();
+  return ng;
+}
@@ -0,0 +1,69 @@
+#include "defines.h"
+#include "kozos.h"
+#include "lib.h"
+
+/*
+  計数セマフォ
+  計数が残っていれば待たずに獲得でき、待ちスレッドは優先度の高い順
+  (同じ優先度なら待ち始めた順)にkz_sem_post()で起こされる
+*/
+
+static kz_sem_id_t sem;
+static char order[4]; /*起こされた補助スレッドの順番*/
+static int ordernum;
+
+static void test11_5_wait(char c)
+{
+  kz_sem_wait(sem);
+  order[ordernum++] = c;
+}
+
+static int test11_5_wait_a(int argc, char *argv[])
+{
+  test11_5_wait('a');
+  return 0;
+}
+
+static int test11_5_wait_b(int argc, char *argv[])
+{
+  test11_5_wait('b');
+  return 0;
+}
+
+static int test11_5_wait_c(int argc, char *argv[])
+{
+  test11_5_wait('c');
+  return 0;
+}
+
+int test11_5_main(int argc, char *argv[])
+{
+  int ng = 0;
+
+  test_begin("test11_5");
+
+  /*計数の分だけ待たずに獲得できる*/
+  sem = kz_sem_create(2);
+  ng += test_check("test11_5 trywait", kz_sem_trywait(sem) == 0);
+  ng += test_check("test11_5 trywait", kz_sem_trywait(sem) == 0);
+  ng += test_check("test11_5 trywait empty", kz_sem_trywait(sem) < 0);
+  kz_sem_post(sem);
+  ng += test_check("test11_5 post counted", kz_sem_trywait(sem) == 0);
+  ng += test_check("test11_5 bad id", kz_sem_post(-1) < 0);
+
+  /*a, b, cの順に待たせ、優先度の高いbから起こされる*/
+  ordernum = 0;
+  test_run(test11_5_wait_a, 1);
+  test_run(test11_5_wait_b, 0);
+  test_run(test11_5_wait_c, 1);
+  ng += test_check("test11_5 all waiting", ordernum == 0);
+  kz_sem_post(sem);
+  ng += test_check("test11_5 wake highest", (ordernum == 1) && (order[0] == 'b'));
+  kz_sem_post(sem);
+  kz_sem_post(sem);
+  ng += test_check("test11_5 wake order", (ordernum == 3) && !strncmp(order, "bac", 3));
+  ng += test_check("test11_5 no count left", kz_sem_trywait(sem) < 0);
+
+  test_end();
+  return ng;
+}
@@ -0,0 +1,64 @@
+#include "defines.h"
+#include "kozos.h"
+#include "lib.h"
+
+/*
+  kz_kmalloc_try()とkz_kmalloc_wait()
+  最大のメモリ・プールを使い切った状態で、tryは待たずにNULLを返し、
+  waitは他のスレッドが解放するまで待って、解放された領域を受け取る
+*/
+
+#define TEST11_6_BLOCK_NUM 16
+
+static char *blocks[TEST11_6_BLOCK_NUM];
+
+/*1つ解放する(テストより優先度が低い)*/
+static int test11_6_free(int argc, char *argv[])
+{
+  kz_kmfree(blocks[0]);
+  return 0;
+}
+
+int test11_6_main(int argc, char *argv[])
+{
+  kz_memstat stats[8];
+  int i, n, num, size, fails, ng = 0;
+  char *p;
+
+  test_begin("test11_6");
+
+  /*最大のプールにだけ入るサイズ(ヘッダは16バイト以下とみて引いておく)*/
+  num = kz_kmstat(stats, sizeof(stats) / sizeof(*stats));
+  size = stats[num - 1].size - 16;
+  n = stats[num - 1].num - stats[num - 1].used;
+  fails = stats[num - 1].fails;
+  if(n > TEST11_6_BLOCK_NUM)
+    n = TEST11_6_BLOCK_NUM;
+
+  for(i = 0; i < n; i++){
+    blocks[i] = kz_kmalloc_try(size);
+    if(blocks[i] == NULL)
+      break;
+  }
+  ng += test_check("test11_6 try alloc", i == n);
+  n = i; /*獲得できた分だけを後で解放する*/
+  ng += test_check("test11_6 try empty", kz_kmalloc_try(size) == NULL);
+  kz_kmstat(stats, num);
+  ng += test_check("test11_6 fails counted", stats[num - 1].fails == fails + 1);
+
+  /*どのプールにも入らない大きさは待たずにNULL*/
+  ng += test_check("test11_6 try too big", kz_kmalloc_try(0x1000) == NULL);
+  ng += test_check("test11_6 wait too big", kz_kmalloc_wait(0x1000) == NULL);
+
+  /*補助スレッドが解放するまで待たされる*/
+  test_run(test11_6_free, 3);
+  p = kz_kmalloc_wait(size);
+  ng += test_check("test11_6 wait freed", p == blocks[0]);
+
+  blocks[0] = p;
+  for(i = 0; i < n; i++)
+    kz_kmfree(blocks[i]);
+
+  test_end();
+  return ng;
+}
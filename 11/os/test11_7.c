@@ -0,0 +1,66 @@
+#include "defines.h"
+#include "kozos.h"
+#include "syscall.h"
+#include "lib.h"
+
+/*
+  kz_msg_alloc()とkz_msg_send()
+  プールが空ならkz_msg_alloc()は待たずにNULLを返し、kz_msg_send()は
+  kz_msg_alloc()で獲得した領域(解放済みでないもの)だけを受け付ける
+*/
+
+#define TEST11_7_BLOCK_NUM 16
+
+static char *blocks[TEST11_7_BLOCK_NUM];
+
+int test11_7_main(int argc, char *argv[])
+{
+  /*ヘッダの分を0で埋めた、kz_msg_alloc()で獲得していない領域*/
+  static char area[sizeof(kz_msgbuf) + 8];
+  kz_memstat stats[8];
+  int i, n, num, size, ng = 0;
+  char *p;
+
+  test_begin("test11_7");
+
+  /*最大のプールにだけ入るサイズ(ヘッダは16バイト以下とみて引いておく)*/
+  num = kz_kmstat(stats, sizeof(stats) / sizeof(*stats));
+  size = stats[num - 1].size - 16 - sizeof(kz_msgbuf);
+  n = stats[num - 1].num - stats[num - 1].used;
+  if(n > TEST11_7_BLOCK_NUM)
+    n = TEST11_7_BLOCK_NUM;
+
+  for(i = 0; i < n; i++){
+    blocks[i] = kz_msg_alloc(size);
+    if(blocks[i] == NULL)
+      break;
+  }
+  ng += test_check("test11_7 alloc", i == n);
+  ng += test_check("test11_7 alloc empty", kz_msg_alloc(size) == NULL);
+  while(i > 0)
+    kz_msg_free(blocks[--i]);
+
+  /*獲得した領域は送信でき、受信した側がそのまま再送できる*/
+  p = kz_msg_alloc(8);
+  ng += test_check("test11_7 alloc small", p != NULL);
+  if(p == NULL){
+    test_end();
+    return ng;
+  }
+  strcpy(p, "msg");
+  ng += test_check("test11_7 send", kz_msg_send(test_box, 4, p) == 4);
+  kz_recv(test_box, &size, &p);
+  ng += test_check("test11_7 recv", !strcmp(p, "msg"));
+  ng += test_check("test11_7 resend", kz_msg_send(test_box, 4, p) == 4);
+  kz_recv(test_box, &size, &p);
+  kz_msg_free(p);
+
+  /*獲得していない領域、解放した領域、NULLは受け付けない*/
+  ng += test_check("test11_7 send static",
+		   kz_msg_send(test_box, 8, area + sizeof(kz_msgbuf)) < 0);
+  ng += test_check("test11_7 send freed", kz_msg_send(test_box, 4, p) < 0);
+  ng += test_check("test11_7 send NULL", kz_msg_send(test_box, 0, NULL) < 0);
+
+  test_end();
+  return ng;
+}
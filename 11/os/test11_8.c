@@ -0,0 +1,51 @@
+#include "defines.h"
+#include "kozos.h"
+#include "lib.h"
+
+/*
+  kz_call()とkz_reply()による要求と応答
+  サーバはkz_recv()で得た呼び出し元のIDに一度だけ応答でき、
+  呼び出し元は応答のサイズと領域を受け取る
+*/
+
+static kz_thread_id_t client;
+static char *requests[2];
+static int rereply; /*同じ呼び出し元への2度目の応答の結果*/
+
+/*要求を2つ受けて応答するサーバ(テストより優先度が高い)*/
+static int test11_8_server(int argc, char *argv[])
+{
+  int i, size;
+
+  for(i = 0; i < 2; i++){
+    client = kz_recv(test_box, &size, &requests[i]);
+    kz_reply(client, 4, i ? "res2" : "res1");
+  }
+  rereply = kz_reply(client, 0, NULL);
+  return 0;
+}
+
+int test11_8_main(int argc, char *argv[])
+{
+  int ng = 0;
+  char *p;
+
+  test_begin("test11_8");
+
+  /*kz_call()で待っていないスレッドへの応答は失敗する*/
+  ng += test_check("test11_8 reply without call", kz_reply(kz_getid(), 0, NULL) < 0);
+
+  test_run(test11_8_server, 1);
+  p = NULL;
+  ng += test_check("test11_8 call size", kz_call(test_box, 5, "req1", &p) == 4);
+  ng += test_check("test11_8 call reply", p && !strncmp(p, "res1", 4));
+  ng += test_check("test11_8 server request", !strcmp(requests[0], "req1"));
+  ng += test_check("test11_8 caller id", client == kz_getid());
+  p = NULL;
+  ng += test_check("test11_8 call size", kz_call(test_box, 5, "req2", &p) == 4);
+  ng += test_check("test11_8 call reply", p && !strncmp(p, "res2", 4));
+  ng += test_check("test11_8 reply once", rereply < 0);
+
+  test_end();
+  return ng;
+}
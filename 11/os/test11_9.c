@@ -0,0 +1,76 @@
+#include "defines.h"
+#include "kozos.h"
+#include "lib.h"
+
+/*
+  メッセージボックスの生成と削除
+  使用中の名前では生成できず、削除すると待っていた受信側と送信側は
+  -1で戻り、古いIDと名前は使えなくなる
+*/
+
+static kz_msgbox_id_t box;
+static int recv_ret;
+static int send_ret;
+
+/*空のメッセージボックスで受信を待つ(テストより優先度が高い)*/
+static int test11_9_recv(int argc, char *argv[])
+{
+  int size;
+  char *p;
+
+  recv_ret = kz_recv(box, &size, &p);
+  return 0;
+}
+
+/*満杯のメッセージボックスに送信して待つ(テストより優先度が高い)*/
+static int test11_9_send(int argc, char *argv[])
+{
+  send_ret = kz_send(box, 3, "m2");
+  return 0;
+}
+
+int test11_9_main(int argc, char *argv[])
+{
+  int ng = 0;
+  kz_msgbox_id_t old, anon;
+
+  test_begin("test11_9");
+
+  /*名前は重複できないが、名前なしはいくつでも作れる*/
+  ng += test_check("test11_9 duplicate name",
+		   kz_msgbox_create("test11_9") == (kz_msgbox_id_t)-1);
+  ng += test_check("test11_9 find", kz_msgbox_find("test11_9") == test_box);
+  anon = kz_msgbox_create(NULL);
+  old = kz_msgbox_create(NULL);
+  ng += test_check("test11_9 unnamed",
+		   (anon != (kz_msgbox_id_t)-1) && (old != (kz_msgbox_id_t)-1));
+  kz_msgbox_delete(anon);
+  kz_msgbox_delete(old);
+  ng += test_check("test11_9 find none", kz_msgbox_find("test11_x") == (kz_msgbox_id_t)-1);
+  ng += test_check("test11_9 delete static", kz_msgbox_delete(MSGBOX_ID_MSGBOX1) < 0);
+
+  /*受信待ちのスレッドがいる状態で削除する*/
+  box = kz_msgbox_create("test11_9b");
+  recv_ret = 0;
+  test_run(test11_9_recv, 1);
+  ng += test_check("test11_9 delete", kz_msgbox_delete(box) == 0);
+  ng += test_check("test11_9 receiver aborted", recv_ret == -1);
+  ng += test_check("test11_9 stale send", kz_send(box, 3, "mx") < 0);
+  ng += test_check("test11_9 stale delete", kz_msgbox_delete(box) < 0);
+  ng += test_check("test11_9 stale find", kz_msgbox_find("test11_9b") == (kz_msgbox_id_t)-1);
+
+  /*削除した名前は再び使え、IDは世代が変わる。送信待ちのスレッドがいる状態で削除する*/
+  old = box;
+  box = kz_msgbox_create("test11_9b");
+  ng += test_check("test11_9 name reused", box != (kz_msgbox_id_t)-1);
+  ng += test_check("test11_9 new generation", box != old);
+  kz_msgbox_setcap(box, 1);
+  kz_send(box, 3, "m1");
+  send_ret = 0;
+  test_run(test11_9_send, 1);
+  ng += test_check("test11_9 delete", kz_msgbox_delete(box) == 0);
+  ng += test_check("test11_9 sender aborted", send_ret == -1);
+
+  test_end();
+  return ng;
+}
@@ -0,0 +1,193 @@
+#include "defines.h"
+#include "timer.h"
+
+/*
+  8ビットタイマのチャネル0,1を16ビットカウントモードで利用する
+  (チャネル0が上位8ビット,チャネル1が下位8ビット)
+*/
+#define H8_3069F_TMR01 ((volatile struct h8_3069f_tmr *)0xffff80)
+
+struct h8_3069f_tmr{
+  volatile uint8 tcr0;
+  volatile uint8 tcr1;
+  volatile uint8 tcsr0;
+  volatile uint8 tcsr1;
+  volatile uint16 tcora; /*TCORA0:TCORA1*/
+  volatile uint16 tcorb; /*TCORB0:TCORB1*/
+  volatile uint16 tcnt;  /*TCNT0:TCNT1*/
+};
+
+#define H8_3069F_TMR_TCR_CKS_STOP    (0<<0)
+#define H8_3069F_TMR_TCR_CKS_PER8    (1<<0)
+#define H8_3069F_TMR_TCR_CKS_PER64   (2<<0)
+#define H8_3069F_TMR_TCR_CKS_PER8192 (3<<0)
+#define H8_3069F_TMR_TCR_CKS_CASCADE (4<<0) /*16ビットカウントモード*/
+#define H8_3069F_TMR_TCR_CCLR_CMA    (1<<3) /*コンペアマッチAでクリア*/
+#define H8_3069F_TMR_TCR_OVIE  (1<<5)
+#define H8_3069F_TMR_TCR_CMIEA (1<<6)
+#define H8_3069F_TMR_TCR_CMIEB (1<<7)
+
+/*
+  16ビットタイマのチャネル2
+  φ/1のフリーランニング・カウンタとして、CPUのステート数の計測に使う
+  オーバーフローはフラグを読み出すときにソフトウェアで上位16ビットに数える
+*/
+#define H8_3069F_TSTR ((volatile uint8 *)0xffff60)
+#define H8_3069F_TISRC ((volatile uint8 *)0xffff66)
+#define H8_3069F_16TMR2 ((volatile struct h8_3069f_16tmr *)0xffff78)
+
+struct h8_3069f_16tmr{
+  volatile uint8 tcr;
+  volatile uint8 tior;
+  volatile uint16 tcnt;
+  volatile uint16 gra;
+  volatile uint16 grb;
+};
+
+#define H8_3069F_16TMR_TCR_TPSC_PER1 (0<<0)
+#define H8_3069F_16TMR_TCR_CCLR_NONE (0<<5)
+#define H8_3069F_TSTR_STR2 (1<<2)
+#define H8_3069F_TISRC_OVF2 (1<<2)
+
+#define H8_3069F_TMR_TCSR_OVF  (1<<5)
+#define H8_3069F_TMR_TCSR_CMFA (1<<6)
+#define H8_3069F_TMR_TCSR_CMFB (1<<7)
+
+#define TIMER_SLEEP_MAX (0x10000 / TIMER_TICK_COUNT) /*ワンショットの最大ティック数*/
+
+/*initiate timer, start periodic tick*/
+int timer_init(void)
+{
+  volatile struct h8_3069f_tmr *tmr = H8_3069F_TMR01;
+
+  tmr->tcr0 = H8_3069F_TMR_TCR_CKS_STOP;
+  tmr->tcr1 = H8_3069F_TMR_TCR_CKS_STOP;
+  tmr->tcsr0 &= ~(H8_3069F_TMR_TCSR_CMFA | H8_3069F_TMR_TCSR_CMFB | H8_3069F_TMR_TCSR_OVF);
+  tmr->tcnt = 0;
+  tmr->tcora = TIMER_TICK_COUNT - 1;
+
+  /*コンペアマッチAで割り込みを発生させ、カウンタをクリアする*/
+  tmr->tcr0 = H8_3069F_TMR_TCR_CMIEA | H8_3069F_TMR_TCR_CCLR_CMA | H8_3069F_TMR_TCR_CKS_CASCADE;
+  tmr->tcr1 = H8_3069F_TMR_TCR_CKS_PER64; /*カウント開始*/
+
+  return 0;
+}
+
+/*has compare match occurred?*/
+int timer_is_expired(void)
+{
+  volatile struct h8_3069f_tmr *tmr = H8_3069F_TMR01;
+  return (tmr->tcsr0 & H8_3069F_TMR_TCSR_CMFA);
+}
+
+/*clear compare match flag*/
+void timer_expire(void)
+{
+  volatile struct h8_3069f_tmr *tmr = H8_3069F_TMR01;
+  tmr->tcsr0 &= ~H8_3069F_TMR_TCSR_CMFA;
+}
+
+/*
+  直前に処理したティックからのカウント数を読み出す
+  コンペアマッチが未処理ならカウンタはクリアされているので、その分を足す
+*/
+static uint32 timer_read(int *matchedp)
+{
+  volatile struct h8_3069f_tmr *tmr = H8_3069F_TMR01;
+  uint32 count;
+  int matched;
+
+  matched = tmr->tcsr0 & H8_3069F_TMR_TCSR_CMFA;
+  count = tmr->tcnt;
+  if(!matched && (tmr->tcsr0 & H8_3069F_TMR_TCSR_CMFA)){
+    /*読み出しの間にコンペアマッチした場合はカウンタを読み直す*/
+    matched = 1;
+    count = tmr->tcnt;
+  }
+  if(matched)
+    count += (uint32)tmr->tcora + 1;
+
+  *matchedp = matched;
+  return count;
+}
+
+/*
+  stop periodic tick, one-shot after ticks (0:max)
+  カウンタは止めずに直前のティックの位置から数え続けるので、
+  コンペアマッチの値を変えるだけでティックの位相はずれない
+*/
+int timer_sleep(int ticks)
+{
+  volatile struct h8_3069f_tmr *tmr = H8_3069F_TMR01;
+
+  if((ticks <= 0) || (ticks > TIMER_SLEEP_MAX))
+    ticks = TIMER_SLEEP_MAX;
+  tmr->tcora = TIMER_TICK_COUNT * ticks - 1;
+  return ticks;
+}
+
+/*
+  restart periodic tick, return elapsed ticks
+  経過したティック数を返し、端数をカウンタに残して周期動作に戻す
+*/
+int timer_wakeup(void)
+{
+  volatile struct h8_3069f_tmr *tmr = H8_3069F_TMR01;
+  uint32 count;
+  int matched;
+
+  count = timer_read(&matched);
+  if(matched)
+    tmr->tcsr0 &= ~H8_3069F_TMR_TCSR_CMFA;
+
+  tmr->tcora = TIMER_TICK_COUNT - 1;
+  tmr->tcnt = count % TIMER_TICK_COUNT;
+  return count / TIMER_TICK_COUNT;
+}
+
+/*get count elapsed since the last tick handled by kernel*/
+uint32 timer_count(void)
+{
+  int matched;
+  return timer_read(&matched);
+}
+
+static uint32 cycle_high; /*サイクル・カウンタの上位(オーバーフローの回数 * 0x10000)*/
+
+/*start 32-bit cycle counter*/
+int timer_cycle_init(void)
+{
+  volatile struct h8_3069f_16tmr *tmr = H8_3069F_16TMR2;
+
+  *H8_3069F_TSTR &= ~H8_3069F_TSTR_STR2;
+  tmr->tcr = H8_3069F_16TMR_TCR_CCLR_NONE | H8_3069F_16TMR_TCR_TPSC_PER1;
+  tmr->tcnt = 0;
+  *H8_3069F_TISRC &= ~H8_3069F_TISRC_OVF2;
+  cycle_high = 0;
+  *H8_3069F_TSTR |= H8_3069F_TSTR_STR2;
+
+  return 0;
+}
+
+/*
+  get cycle counter (call at least every 65536 cycles)
+  読み出しの間にオーバーフローした場合はカウンタを読み直す(timer_read()と同じ)
+*/
+uint32 timer_cycle(void)
+{
+  volatile struct h8_3069f_16tmr *tmr = H8_3069F_16TMR2;
+  uint16 count;
+  int overflowed;
+
+  overflowed = *H8_3069F_TISRC & H8_3069F_TISRC_OVF2;
+  count = tmr->tcnt;
+  if(!overflowed && (*H8_3069F_TISRC & H8_3069F_TISRC_OVF2)){
+    overflowed = 1;
+    count = tmr->tcnt;
+  }
+  if(overflowed){
+    *H8_3069F_TISRC &= ~H8_3069F_TISRC_OVF2;
+    cycle_high += 0x10000;
+  }
+  return cycle_high + count;
+}
@@ -0,0 +1,17 @@
+#ifndef _TIMER_H_INCLUDE_
+#define _TIMER_H_INCLUDE_
+
+#define TIMER_TICK_MSEC 10 /*システム・クロック(ティック)の周期[ms]*/
+#define TIMER_CLOCK_HZ (20000000 / 64) /*カウンタのクロック(20MHzのφ/64)*/
+#define TIMER_TICK_COUNT ((uint32)TIMER_CLOCK_HZ * TIMER_TICK_MSEC / 1000)
+
+int timer_init(void); /*initiate timer, start periodic tick*/
+int timer_is_expired(void); /*has compare match occurred?*/
+void timer_expire(void); /*clear compare match flag*/
+int timer_sleep(int ticks); /*stop periodic tick, one-shot after ticks (0:max)*/
+int timer_wakeup(void); /*restart periodic tick, return elapsed ticks*/
+uint32 timer_count(void); /*get count elapsed since the last tick handled by kernel*/
+int timer_cycle_init(void); /*start 32-bit cycle counter*/
+uint32 timer_cycle(void); /*get cycle counter (call at least every 65536 cycles)*/
+
+#endif
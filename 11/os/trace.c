@@ -0,0 +1,133 @@
+#include "defines.h"
+#include "kozos.h"
+#include "serial.h"
+#include "timer.h"
+#include "lib.h"
+#include "trace.h"
+
+#ifdef KZ_TRACE
+
+#define KZTRACE_NUM 128 /*リングバッファに保持するイベント数*/
+#define KZTRACE_NAME_NUM THREAD_NUM /*名前を記録するスレッド数(TCBの番号で管理)*/
+#if THREAD_NUM > KZTRACE_NOTHREAD
+#error "THREAD_NUM must be less than KZTRACE_NOTHREAD with KZ_TRACE"
+#endif
+#define KZTRACE_NAME_SIZE 16
+#define KZTRACE_VERSION 1
+
+/*イベント1個分(8バイト)*/
+typedef struct{
+  uint32 time; /*カーネルの時刻(タイマのカウント数)*/
+  uint8 type;
+  uint8 thread; /*TCBの番号*/
+  uint16 arg;
+}kztrace_record;
+
+static kztrace_record records[KZTRACE_NUM];
+static int head; /*次に書き込む位置*/
+static int count; /*保持しているイベント数*/
+static char names[KZTRACE_NAME_NUM][KZTRACE_NAME_SIZE];
+static volatile int stopped; /*ダンプ中は記録しない*/
+
+/*イベントの記録(カーネルから割り込み禁止で呼ばれる)*/
+void kztrace_put(uint32 time, int type, int thread, int arg)
+{
+  kztrace_record *rp;
+
+  if(stopped)
+    return;
+
+  rp = &records[head];
+  rp->time = time;
+  rp->type = type;
+  rp->thread = thread;
+  rp->arg = arg;
+
+  head = (head + 1) % KZTRACE_NUM;
+  if(count < KZTRACE_NUM)
+    count++;
+}
+
+/*スレッド名の記録(ダンプの際にスレッドの表示に使う)*/
+void kztrace_name(int thread, char *name)
+{
+  if(thread < KZTRACE_NAME_NUM){
+    memset(names[thread], 0, KZTRACE_NAME_SIZE);
+    strcpy(names[thread], name);
+  }
+}
+
+/*
+  バイナリのまま送信する
+  putc()は改行コードを変換してしまうので、直接シリアルに出力する
+*/
+static void dump_byte(int c)
+{
+  serial_send_byte(SERIAL_DEFAULT_DEVICE, c);
+}
+
+static void dump_word(uint16 w)
+{
+  dump_byte(w >> 8);
+  dump_byte(w & 0xff);
+}
+
+static void dump_long(uint32 l)
+{
+  dump_word(l >> 16);
+  dump_word(l & 0xffff);
+}
+
+/*
+  トレースのダンプ(スレッドから呼び出す)
+  以下のバイナリ(ビッグエンディアン)をシリアルに出力する。
+  ホスト側でtools/kztraceによりChrome trace形式のJSONに変換できる
+    "KZTR", バージョン(2), タイマのクロック[Hz](4),
+    名前の数(2), イベント数(2),
+    名前 * (TCBの番号(1), 名前(16)),
+    イベント * (時刻(4), 種別(1), TCBの番号(1), 引数(2)) 古い順
+*/
+void kztrace_dump(void)
+{
+  int i, n, num;
+
+  stopped = 1;
+
+  for(i = 0, n = 0; i < KZTRACE_NAME_NUM; i++){
+    if(names[i][0])
+      n++;
+  }
+  num = count;
+
+  dump_byte('K');
+  dump_byte('Z');
+  dump_byte('T');
+  dump_byte('R');
+  dump_word(KZTRACE_VERSION);
+  dump_long(TIMER_CLOCK_HZ);
+  dump_word(n);
+  dump_word(num);
+
+  for(i = 0; i < KZTRACE_NAME_NUM; i++){
+    if(!names[i][0])
+      continue;
+    dump_byte(i);
+    for(n = 0; n < KZTRACE_NAME_SIZE; n++)
+      dump_byte(names[i][n]);
+  }
+
+  for(i = (head + KZTRACE_NUM - num) % KZTRACE_NUM; num > 0; num--){
+    dump_long(records[i].time);
+    dump_byte(records[i].type);
+    dump_byte(records[i].thread);
+    dump_word(records[i].arg);
+    i = (i + 1) % KZTRACE_NUM;
+  }
+
+  /*ダンプしたイベントは捨てて記録を再開する*/
+  head = 0;
+  count = 0;
+  stopped = 0;
+}
+
+#endif
@@ -0,0 +1,31 @@
+#ifndef _KOZOS_TRACE_H_INCLUDE_
+#define _KOZOS_TRACE_H_INCLUDE_
+
+#include "defines.h"
+
+/*
+  カーネル・イベントのトレース
+  KZ_TRACEを定義してビルドした場合のみ有効になる
+*/
+
+/*イベントの種別*/
+#define KZTRACE_SWITCH  1 /*スレッドの切り替え(arg:切り替え前のスレッド)*/
+#define KZTRACE_SYSCALL 2 /*システムコール(arg:システムコール番号)*/
+#define KZTRACE_INTR    3 /*割り込み(arg:ソフトウェア割り込みベクタの種別)*/
+#define KZTRACE_SEND    4 /*メッセージ送信(arg:メッセージボックスID)*/
+#define KZTRACE_RECV    5 /*メッセージ受信(arg:メッセージボックスID)*/
+#define KZTRACE_RUN     6 /*スレッドの生成(arg:優先度)*/
+#define KZTRACE_EXIT    7 /*スレッドの終了*/
+
+#define KZTRACE_NOTHREAD 0xff /*スレッドなし(割り込みハンドラからの送信など)*/
+
+#ifdef KZ_TRACE
+void kztrace_put(uint32 time, int type, int thread, int arg);
+void kztrace_name(int thread, char *name);
+void kztrace_dump(void);
+#define KZTRACE(time, type, thread, arg) kztrace_put((time), (type), (thread), (arg))
+#else
+#define KZTRACE(time, type, thread, arg)
+#endif
+
+#endif
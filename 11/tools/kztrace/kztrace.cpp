@@ -0,0 +1,286 @@
+/*
+  kztrace: KOZOSのトレースのダンプ(kztrace_dump()の出力)を
+  Chrome trace / Perfetto で表示できるJSONに変換する
+
+  使い方: kztrace dump.bin > trace.json
+  シリアルのログをそのまま渡してよい(先頭の"KZTR"を探して読む)
+*/
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace {
+
+/*trace.hと同じ値*/
+enum {
+  KZTRACE_SWITCH = 1,
+  KZTRACE_SYSCALL,
+  KZTRACE_INTR,
+  KZTRACE_SEND,
+  KZTRACE_RECV,
+  KZTRACE_RUN,
+  KZTRACE_EXIT,
+};
+const int KZTRACE_NOTHREAD = 0xff;
+const int KZTRACE_NAME_SIZE = 16;
+
+/*syscall.hのkz_syscall_type_tと同じ順*/
+const char *syscall_names[] = {
+  "kz_run", "kz_exit", "kz_wait", "kz_sleep", "kz_wakeup", "kz_getid",
+  "kz_chpri", "kz_kmalloc", "kz_kmfree", "kz_send", "kz_recv", "kz_delay",
+  "kz_mutex_create", "kz_mutex_lock", "kz_mutex_unlock",
+  "kz_sem_create", "kz_sem_wait", "kz_sem_post", "kz_stackused",
+  "kz_getstat", "kz_kmstat", "kz_msg_send",
+  "kz_call", "kz_reply", "kz_msgbox_setcap",
+  "kz_msgbox_create", "kz_msgbox_delete", "kz_msgbox_find",
+  "kz_recv_batch", "kz_setintr",
+};
+
+/*intr.hのSOFTVEC_TYPE_*と同じ順*/
+const char *intr_names[] = {
+  "softerr", "syscall", "serintr", "timintr",
+};
+
+struct Record {
+  uint64_t time;
+  int type;
+  int thread;
+  int arg;
+};
+
+struct Trace {
+  uint32_t clock_hz = 0;
+  std::map<int, std::string> names;
+  std::vector<Record> records;
+};
+
+class Reader {
+public:
+  Reader(const std::vector<uint8_t> &data, size_t pos) : data_(data), pos_(pos) {}
+
+  bool ok(size_t n) const { return pos_ + n <= data_.size(); }
+  uint8_t byte() { return data_[pos_++]; }
+  uint16_t word() { uint16_t w = byte() << 8; return w | byte(); }
+  uint32_t dword() { uint32_t l = uint32_t(word()) << 16; return l | word(); }
+
+private:
+  const std::vector<uint8_t> &data_;
+  size_t pos_;
+};
+
+bool parse(const std::vector<uint8_t> &data, Trace *trace)
+{
+  static const char magic[] = {'K', 'Z', 'T', 'R'};
+  size_t pos;
+
+  for (pos = 0; pos + sizeof(magic) <= data.size(); pos++) {
+    if (std::equal(magic, magic + sizeof(magic), data.begin() + pos))
+      break;
+  }
+  if (pos + sizeof(magic) > data.size()) {
+    std::cerr << "kztrace: no trace header found" << std::endl;
+    return false;
+  }
+
+  Reader r(data, pos + sizeof(magic));
+  if (!r.ok(12))
+    return false;
+  int version = r.word();
+  if (version != 1) {
+    std::cerr << "kztrace: unsupported version " << version << std::endl;
+    return false;
+  }
+  trace->clock_hz = r.dword();
+  int nnames = r.word();
+  int nrecords = r.word();
+
+  for (int i = 0; i < nnames; i++) {
+    if (!r.ok(1 + KZTRACE_NAME_SIZE))
+      return false;
+    int thread = r.byte();
+    std::string name;
+    for (int j = 0; j < KZTRACE_NAME_SIZE; j++) {
+      char c = r.byte();
+      if (c)
+        name += c;
+    }
+    trace->names[thread] = name;
+  }
+
+  /*時刻は32ビットで一周するので、戻ったら桁上げする*/
+  uint64_t base = 0;
+  uint32_t last = 0;
+  for (int i = 0; i < nrecords; i++) {
+    if (!r.ok(8)) {
+      std::cerr << "kztrace: truncated after " << i << " events" << std::endl;
+      break;
+    }
+    Record rec;
+    uint32_t t = r.dword();
+    if (i > 0 && t < last)
+      base += uint64_t(1) << 32;
+    last = t;
+    rec.time = base + t;
+    rec.type = r.byte();
+    rec.thread = r.byte();
+    rec.arg = r.word();
+    trace->records.push_back(rec);
+  }
+  return true;
+}
+
+std::string quote(const std::string &s)
+{
+  std::string q = "\"";
+  for (char c : s) {
+    if (c == '"' || c == '\\') {
+      q += '\\';
+      q += c;
+    } else if (static_cast<unsigned char>(c) < 0x20) {
+      char buf[8];
+      std::snprintf(buf, sizeof(buf), "\\u%04x", c);
+      q += buf;
+    } else {
+      q += c;
+    }
+  }
+  return q + "\"";
+}
+
+template <typename T, size_t N>
+std::string lookup(const T (&table)[N], int i, const char *prefix)
+{
+  if (i >= 0 && static_cast<size_t>(i) < N)
+    return table[i];
+  return prefix + std::to_string(i);
+}
+
+class Writer {
+public:
+  Writer(std::ostream &out, const Trace &trace) : out_(out), trace_(trace) {}
+
+  void write()
+  {
+    out_.setf(std::ios::fixed);
+    out_.precision(3);
+    out_ << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n";
+    metadata();
+
+    int running = -1;
+    uint64_t last = 0;
+    for (const Record &rec : trace_.records) {
+      last = rec.time;
+      switch (rec.type) {
+      case KZTRACE_SWITCH:
+        if (running >= 0)
+          event("E", "run", running, rec.time);
+        running = rec.thread;
+        event("B", "run", running, rec.time);
+        break;
+      case KZTRACE_SYSCALL:
+        instant(lookup(syscall_names, rec.arg, "syscall "), rec.thread, rec.time, "");
+        break;
+      case KZTRACE_INTR:
+        instant(lookup(intr_names, rec.arg, "intr "), rec.thread, rec.time, "");
+        break;
+      case KZTRACE_SEND:
+        instant("send", rec.thread, rec.time, "\"msgbox\":" + std::to_string(rec.arg));
+        break;
+      case KZTRACE_RECV:
+        instant("recv", rec.thread, rec.time, "\"msgbox\":" + std::to_string(rec.arg));
+        break;
+      case KZTRACE_RUN:
+        instant("thread run", rec.thread, rec.time, "\"priority\":" + std::to_string(rec.arg));
+        break;
+      case KZTRACE_EXIT:
+        instant("thread exit", rec.thread, rec.time, "");
+        break;
+      default:
+        instant("unknown " + std::to_string(rec.type), rec.thread, rec.time, "");
+        break;
+      }
+    }
+    if (running >= 0)
+      event("E", "run", running, last);
+
+    out_ << "\n]}\n";
+  }
+
+private:
+  /*タイマのカウント数をマイクロ秒に変換する*/
+  double usec(uint64_t time) const
+  {
+    return trace_.clock_hz ? time * 1e6 / trace_.clock_hz : double(time);
+  }
+
+  void separator()
+  {
+    if (!first_)
+      out_ << ",\n";
+    first_ = false;
+  }
+
+  void metadata()
+  {
+    separator();
+    out_ << "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"args\":{\"name\":\"kozos\"}}";
+    for (const auto &n : trace_.names) {
+      separator();
+      out_ << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << n.first
+           << ",\"args\":{\"name\":" << quote(n.second) << "}}";
+    }
+    separator();
+    out_ << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << KZTRACE_NOTHREAD
+         << ",\"args\":{\"name\":\"interrupt\"}}";
+  }
+
+  void event(const char *ph, const std::string &name, int thread, uint64_t time)
+  {
+    separator();
+    out_ << "{\"name\":" << quote(name) << ",\"ph\":\"" << ph << "\",\"pid\":1,\"tid\":"
+         << thread << ",\"ts\":" << usec(time) << "}";
+  }
+
+  void instant(const std::string &name, int thread, uint64_t time, const std::string &args)
+  {
+    separator();
+    out_ << "{\"name\":" << quote(name) << ",\"ph\":\"i\",\"s\":\"t\",\"pid\":1,\"tid\":"
+         << thread << ",\"ts\":" << usec(time) << ",\"args\":{" << args << "}}";
+  }
+
+  std::ostream &out_;
+  const Trace &trace_;
+  bool first_ = true;
+};
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+  if (argc != 2) {
+    std::cerr << "usage: kztrace <dump file>" << std::endl;
+    return 1;
+  }
+
+  std::ifstream in(argv[1], std::ios::binary);
+  if (!in) {
+    std::cerr << "kztrace: cannot open " << argv[1] << std::endl;
+    return 1;
+  }
+  std::vector<uint8_t> data((std::istreambuf_iterator<char>(in)),
+                            std::istreambuf_iterator<char>());
+
+  Trace trace;
+  if (!parse(data, &trace))
+    return 1;
+
+  Writer(std::cout, trace).write();
+  return 0;
+}